@@ -0,0 +1,213 @@
+/* Choosing the number of points of circles automatically
+
+compile with:  g++ -c Adaptive_Tessellation.cpp
+and then link to get the executable with:
+
+    g++ Adaptive_Tessellation.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+As the shapes tutorial explains, circles are approximated by polygons, and the
+number of points defines the quality of the approximation: "If you draw small
+circles, you'll probably only need a few sides. If you draw big circles, or
+zoom on regular circles, you'll most likely need more sides."
+
+But what matters is not the radius of the circle: it's its size on screen,
+after its own transform and the view have been applied. The same circle of
+radius 10 covers 2 pixels when the view is zoomed out, and 500 when it's zoomed
+in. With a fixed number of points (30 by default), tiny circles waste vertices,
+and huge ones show their facets.
+
+The right number of points can be computed. A polygon of n points inscribed in
+a circle of radius r deviates from the circle by at most r * (1 - cos(pi / n)),
+in the middle of each side. If we accept an error of e pixels, and r is the
+radius in pixels, we need:
+
+    n >= pi / acos(1 - e / r)
+
+Since acos(1 - x) is close to (and always above) sqrt(2x), a cheaper estimate
+which is never too low is n = pi * sqrt(r / (2e)). A circle that spans the
+whole screen (r = 400) with a quarter of a pixel of error needs about 90
+points; a circle of radius 2 pixels only needs 8.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+/* The tessellation policy
+
+The policy needs to know how many pixels one unit of the scene covers, which
+depends on the current view and on the size of the target: setTarget must be
+called whenever one of them changes (typically once per frame, before
+updating the shapes).
+
+The computed point count is rounded up to one of a few levels. This way, a
+circle that grows slowly doesn't change its point count (and rebuild its
+geometry) at every frame. Few point counts are used, which also suits the
+EllipseShape class of the shapes tutorial: its points come from a unit circle
+computed once per point count by getUnitCircle, so all the ellipses of a level
+share a single table (sf::CircleShape, on the other hand, computes a cosine
+and a sine per point whenever its point count changes).*/
+class TessellationPolicy
+{
+public:
+
+    // tolerance is the maximum distance, in pixels, between the polygon and
+    // the real circle; it is clamped to 1/100 of a pixel, since a null or
+    // negative tolerance would ask for an infinite number of points
+    explicit TessellationPolicy(float tolerance = 0.25f,
+                                std::size_t minPoints = 6,
+                                std::size_t maxPoints = 512) :
+    m_tolerance(std::max(tolerance, 0.01f)),
+    m_minPoints(minPoints),
+    m_maxPoints(maxPoints),
+    m_pixelsPerUnit(1.f)
+    {
+    }
+
+    // read the current view of the target
+    void setTarget(const sf::RenderTarget& target)
+    {
+        const sf::View& view = target.getView();
+        sf::IntRect viewport = target.getViewport(view);
+
+        float x = viewport.width / std::abs(view.getSize().x);
+        float y = viewport.height / std::abs(view.getSize().y);
+        m_pixelsPerUnit = std::max(x, y);
+    }
+
+    // number of points for a circle of the given (local) radius, drawn with
+    // the given transform
+    std::size_t getPointCount(float radius, const sf::Transform& transform) const
+    {
+        // the largest scale factor of the transform: the length of the
+        // longest of its two axes
+        const float* matrix = transform.getMatrix();
+        float xAxis = matrix[0] * matrix[0] + matrix[1] * matrix[1];
+        float yAxis = matrix[4] * matrix[4] + matrix[5] * matrix[5];
+        float scale = std::sqrt(std::max(xAxis, yAxis));
+
+        float pixels = radius * scale * m_pixelsPerUnit;
+        float count = 3.141592654f * std::sqrt(pixels / (2 * m_tolerance));
+
+        // clamp before converting: a huge (or infinite, or NaN) count can't be
+        // converted to an integer
+        if (!(count < m_maxPoints))
+            count = static_cast<float>(m_maxPoints);
+
+        return getLevel(static_cast<std::size_t>(std::ceil(count)));
+    }
+
+    // update the point count of a circle, only if it changed (setPointCount
+    // recomputes the whole geometry of the shape)
+    void apply(sf::CircleShape& circle) const
+    {
+        std::size_t count = getPointCount(circle.getRadius(), circle.getTransform());
+        if (count != circle.getPointCount())
+            circle.setPointCount(count);
+    }
+
+private:
+
+    // round up to the next level: 6, 8, 12, 16, 24, 32, 48, 64, ...
+    std::size_t getLevel(std::size_t count) const
+    {
+        count = std::max(count, m_minPoints);
+
+        std::size_t level = 4;
+        while (level < count)
+        {
+            if (level + level / 2 >= count)
+            {
+                level += level / 2;
+                break;
+            }
+            level *= 2;
+        }
+
+        return std::min(std::max(level, m_minPoints), m_maxPoints);
+    }
+
+    float m_tolerance;
+    std::size_t m_minPoints;
+    std::size_t m_maxPoints;
+    float m_pixelsPerUnit;
+};
+
+//The same policy works for the EllipseShape class of the shapes tutorial: use
+//its largest radius, and only call setPointCount when the result changes.
+//
+//    sf::Vector2f radius = ellipse.getRadius();
+//    std::size_t count = policy.getPointCount(std::max(radius.x, radius.y),
+//                                             ellipse.getTransform());
+//    if (count != ellipse.getPointCount())
+//        ellipse.setPointCount(count);
+
+//Since the policy only needs a radius and a transform, it's also useful if you
+//build the geometry of your circles yourself, for example in a shape batch:
+//pass the transform of the circle combined with any parent transform.
+
+/* A demo with 20000 circles: zoom with the mouse wheel, and watch the number
+of vertices in the console. Zoomed out, it's a fraction of what the default
+30 points per circle would give. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Adaptive tessellation");
+
+    std::vector<sf::CircleShape> circles(20000);
+    for (std::size_t i = 0; i < circles.size(); ++i)
+    {
+        float radius = static_cast<float>(1 + std::rand() % 20);
+        circles[i].setRadius(radius);
+        circles[i].setOrigin(radius, radius);
+        circles[i].setPosition(static_cast<float>(std::rand() % 8000),
+                               static_cast<float>(std::rand() % 6000));
+        circles[i].setFillColor(sf::Color(std::rand() % 256, std::rand() % 256, 255));
+    }
+
+    // start fully zoomed out
+    sf::View view(sf::FloatRect(0, 0, 8000, 6000));
+    TessellationPolicy policy;
+    sf::Clock report;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+
+            if (event.type == sf::Event::MouseWheelScrolled)
+                view.zoom(event.mouseWheelScroll.delta > 0 ? 0.8f : 1.25f);
+        }
+
+        window.setView(view);
+        policy.setTarget(window);
+
+        std::size_t vertices = 0;
+        for (std::size_t i = 0; i < circles.size(); ++i)
+        {
+            policy.apply(circles[i]);
+            vertices += circles[i].getPointCount();
+        }
+
+        if (report.getElapsedTime() > sf::seconds(1))
+        {
+            std::cout << vertices << " points (" << circles.size() * 30
+                      << " with 30 points per circle)" << std::endl;
+            report.restart();
+        }
+
+        window.clear();
+        for (std::size_t i = 0; i < circles.size(); ++i)
+            window.draw(circles[i]);
+        window.display();
+    }
+
+    return 0;
+}
@@ -0,0 +1,357 @@
+/* Loading textures in the background
+
+compile with:  g++ -std=c++11 -c Async_Texture_Loading.cpp
+and then link to get the executable with:
+
+    g++ Async_Texture_Loading.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system -pthread
+*/
+
+/* Introduction
+
+texture.loadFromFile("image.png") does three things, and the calling thread
+waits for all of them: it reads the file, decodes the image into pixels, and
+uploads these pixels to video memory. With a few hundred textures to load, a
+level transition freezes the window for seconds.
+
+Only the last step has to happen on the thread which owns the OpenGL context.
+Reading and decoding only produce a sf::Image, and as the sprites tutorial
+explains, an image is just pixels in system memory: any thread can create one.
+
+So the loader below splits the work in two:
+
+1. worker threads read and decode files into sf::Image instances
+2. the main thread uploads decoded images to sf::Texture instances, but only
+   for a limited amount of time per frame, so that it keeps drawing at full
+   frame rate while textures arrive one after the other
+
+Loading a texture returns a handle immediately. The handle becomes ready a few
+frames later, when its texture is fully uploaded.*/
+
+#include <SFML/Graphics.hpp>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* The handle
+
+A handle shares the state of one request with the loader. It is cheap to copy,
+and the texture that it refers to lives as long as at least one handle (or the
+loader) still refers to it -- so there's no risk of a white square here.
+
+The state is handed from thread to thread, and only one of them uses it at a
+time. While a request is queued for decoding, no thread touches it. A worker
+then takes it out of the queue and fills image and decoded. Then it puts the
+state in the queue of decoded images, which the main thread empties in
+TextureLoader::update. Each queue is protected by the mutex of the loader, so
+the main thread sees everything the worker wrote. status, texture and
+uploadedRows are only modified by the main thread, so reading them from the
+main thread needs no lock. image and decoded must not be read before the
+request has left the worker.*/
+class TextureHandle
+{
+public:
+
+    enum Status
+    {
+        Pending,
+        Ready,
+        Failed
+    };
+
+    TextureHandle()
+    {
+    }
+
+    bool isValid() const
+    {
+        return m_state != NULL;
+    }
+
+    bool isReady() const
+    {
+        return m_state && m_state->status == Ready;
+    }
+
+    bool hasFailed() const
+    {
+        return m_state && m_state->status == Failed;
+    }
+
+    // only valid once isReady() returns true
+    const sf::Texture& getTexture() const
+    {
+        return m_state->texture;
+    }
+
+private:
+
+    friend class TextureLoader;
+
+    struct State
+    {
+        State(const std::string& path) :
+        path(path),
+        status(Pending),
+        uploadedRows(0),
+        decoded(false)
+        {
+        }
+
+        std::string path;
+        Status status;
+        sf::Texture texture;
+        sf::Image image;           // filled by a worker, released after upload
+        unsigned int uploadedRows; // progress of the upload, see uploadStrip()
+        bool decoded;
+    };
+
+    explicit TextureHandle(const std::shared_ptr<State>& state) :
+    m_state(state)
+    {
+    }
+
+    std::shared_ptr<State> m_state;
+};
+
+/* The loader
+
+The workers wait on a condition variable: like a thread locked on a sf::Mutex,
+a waiting worker consumes no CPU. We use the C++11 threading primitives here
+rather than sf::Thread and sf::Mutex, because SFML offers no condition
+variable.*/
+class TextureLoader
+{
+public:
+
+    // by default, keep one core for the main thread
+    explicit TextureLoader(unsigned int workerCount = 0) :
+    m_inFlight(0),
+    m_stop(false)
+    {
+        if (workerCount == 0)
+        {
+            unsigned int cores = std::thread::hardware_concurrency();
+            workerCount = cores > 1 ? cores - 1 : 1;
+        }
+
+        for (unsigned int i = 0; i < workerCount; ++i)
+            m_workers.push_back(std::thread(&TextureLoader::work, this));
+    }
+
+    ~TextureLoader()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+
+        for (std::size_t i = 0; i < m_workers.size(); ++i)
+            m_workers[i].join();
+    }
+
+    // queue a file for loading; this function returns immediately
+    TextureHandle load(const std::string& path)
+    {
+        std::shared_ptr<TextureHandle::State> state =
+            std::make_shared<TextureHandle::State>(path);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_toDecode.push_back(state);
+        }
+        m_wakeUp.notify_one();
+
+        return TextureHandle(state);
+    }
+
+    // upload decoded images to video memory, for at most the given duration;
+    // must be called regularly (once per frame) by the thread that owns the
+    // OpenGL context
+    void update(sf::Time budget)
+    {
+        sf::Clock clock;
+
+        while (clock.getElapsedTime() < budget)
+        {
+            // continue the current upload, or take the next decoded image
+            if (!m_uploading)
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                if (m_decoded.empty())
+                    return;
+
+                m_uploading = m_decoded.front();
+                m_decoded.pop_front();
+            }
+
+            if (uploadStrip(*m_uploading))
+                m_uploading.reset();
+        }
+    }
+
+    // number of requests which are not ready (or failed) yet
+    std::size_t getPendingCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_toDecode.size() + m_inFlight + m_decoded.size() +
+               (m_uploading ? 1 : 0);
+    }
+
+private:
+
+    typedef std::shared_ptr<TextureHandle::State> StatePtr;
+
+    // worker thread entry point
+    void work()
+    {
+        for (;;)
+        {
+            StatePtr state;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_wakeUp.wait(lock, [this]() { return m_stop || !m_toDecode.empty(); });
+
+                if (m_stop)
+                    return;
+
+                state = m_toDecode.front();
+                m_toDecode.pop_front();
+                ++m_inFlight;
+            }
+
+            // the slow part: file access and decoding, without holding the lock
+            state->decoded = state->image.loadFromFile(state->path);
+
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_inFlight;
+            m_decoded.push_back(state);
+        }
+    }
+
+    // upload the next rows of an image; returns true when the request is done
+    //
+    // uploading a 4096x4096 image in one go would blow the frame budget on its
+    // own, so large images are uploaded in strips of a few hundred rows
+    bool uploadStrip(TextureHandle::State& state)
+    {
+        if (!state.decoded)
+        {
+            state.status = TextureHandle::Failed;
+            return true;
+        }
+
+        sf::Vector2u size = state.image.getSize();
+
+        if (state.uploadedRows == 0 && !state.texture.create(size.x, size.y))
+        {
+            state.status = TextureHandle::Failed;
+            state.image = sf::Image();
+            return true;
+        }
+
+        // aim for about 1 MB per strip
+        unsigned int rows = size.x > 0 ? (1024 * 1024 / 4) / size.x : size.y;
+        if (rows == 0)
+            rows = 1;
+        if (rows > size.y - state.uploadedRows)
+            rows = size.y - state.uploadedRows;
+
+        const sf::Uint8* pixels = state.image.getPixelsPtr() +
+                                  static_cast<std::size_t>(state.uploadedRows) * size.x * 4;
+        state.texture.update(pixels, size.x, rows, 0, state.uploadedRows);
+        state.uploadedRows += rows;
+
+        if (state.uploadedRows < size.y)
+            return false;
+
+        // the pixels are in video memory now, release the system memory copy
+        state.image = sf::Image();
+        state.status = TextureHandle::Ready;
+        return true;
+    }
+
+    std::vector<std::thread> m_workers;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_wakeUp;
+    std::deque<StatePtr> m_toDecode;   // waiting for a worker
+    std::deque<StatePtr> m_decoded;    // waiting for the main thread
+    std::size_t m_inFlight;            // being decoded by a worker
+    StatePtr m_uploading;              // only accessed by the main thread
+    bool m_stop;
+};
+
+//The per-frame budget is a trade-off: the bigger it is, the sooner the loading
+//is over, but the closer you get to missing a frame. At 60 FPS a frame lasts
+//16.6 ms, so a few milliseconds is usually a good choice.
+
+//Keep in mind that texture.update only sends the pixels to the driver, which
+//may still do some work later. That's why the budget is checked between
+//strips, rather than trusting that the upload is finished when it returns.
+
+/* And a loading screen that keeps animating while 100 textures load: */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Loading...");
+    window.setVerticalSyncEnabled(true);
+
+    TextureLoader loader;
+
+    std::vector<TextureHandle> textures;
+    for (int i = 0; i < 100; ++i)
+    {
+        std::ostringstream path;
+        path << "textures/texture" << i << ".png";
+        textures.push_back(loader.load(path.str()));
+    }
+
+    // a spinning square, to see that the window never freezes
+    sf::RectangleShape spinner(sf::Vector2f(50, 50));
+    spinner.setOrigin(25, 25);
+    spinner.setPosition(400, 300);
+
+    sf::Clock clock;
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        // spend at most 4 ms per frame uploading textures
+        loader.update(sf::milliseconds(4));
+
+        spinner.rotate(clock.restart().asSeconds() * 180.f);
+
+        window.clear();
+        if (loader.getPendingCount() > 0)
+        {
+            window.draw(spinner);
+        }
+        else
+        {
+            // everything is loaded: draw the textures that loaded successfully
+            sf::Sprite sprite;
+            for (std::size_t i = 0; i < textures.size(); ++i)
+            {
+                if (!textures[i].isReady())
+                    continue;
+
+                sprite.setTexture(textures[i].getTexture(), true);
+                sprite.setPosition(static_cast<float>((i % 10) * 80),
+                                   static_cast<float>((i / 10) * 60));
+                window.draw(sprite);
+            }
+        }
+        window.display();
+    }
+
+    return 0;
+}
@@ -0,0 +1,393 @@
+/* Skipping image decoding at startup
+
+compile with:  g++ -c Decoded_Texture_Cache.cpp
+and then link to get the executable with:
+
+    g++ Decoded_Texture_Cache.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system -lGL
+*/
+
+/* Introduction
+
+Every time the game starts, texture.loadFromFile decodes the same PNG files
+into the same pixels. PNG is a compressed format: decoding it costs far more
+CPU time than reading the file, and it's very often what dominates the startup
+time of a game with a lot of textures.
+
+Since the decoded pixels are always the same, we can store them once, after the
+first decoding, in a raw file: a small header followed by the RGBA pixels. On
+the next launches, the cache file is mapped in memory and its pixels are sent
+directly to texture.update -- no decoding at all, and not even a copy in a
+buffer of our own: the pages of the file are read by the OS as the driver
+reads the pixels.
+
+A cache file is only valid as long as its source file doesn't change, so the
+header records the size and the modification time of the source. If they don't
+match anymore, the entry is stale and is silently regenerated.
+
+The cache files are uncompressed, so they take more disk space than the PNG
+files; that's the price to pay. They are also specific to the machine, so
+generate them on the player's machine (at first launch), don't ship them.
+
+Memory mapping is done with the POSIX functions mmap and munmap here (Linux,
+macOS). On Windows, CreateFileMapping and MapViewOfFile do the same thing.*/
+
+#include <SFML/Graphics.hpp>
+#include <SFML/OpenGL.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The cache file format
+
+The header and the path of the source file are padded to 4096 bytes, which is
+the size of a memory page on most systems: the pixels therefore start on a
+page boundary, and the mapping can be handed to the driver without any
+realignment. When mipmaps are stored, the levels follow each other, from the
+full size image to the 1x1 one.*/
+namespace
+{
+    const sf::Uint32 cacheMagic = 0x43544653; // "SFTC"
+    const sf::Uint32 cacheVersion = 1;
+    const std::size_t cacheDataOffset = 4096;
+
+    struct CacheHeader
+    {
+        sf::Uint32 magic;
+        sf::Uint32 version;
+        sf::Uint32 width;
+        sf::Uint32 height;
+        sf::Uint32 levels;       // 1 if no mipmaps are stored
+        sf::Uint32 dataOffset;   // offset of the first pixel in the file
+        sf::Uint64 sourceSize;   // used to detect modified source files
+        sf::Int64  sourceTime;
+        sf::Uint32 pathLength;   // the source path follows the header, to
+                                 // detect (unlikely) file name collisions
+    };
+
+    // FNV-1a: simple and good enough to turn a path into a file name
+    sf::Uint64 hash(const std::string& string)
+    {
+        sf::Uint64 value = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < string.size(); ++i)
+        {
+            value ^= static_cast<unsigned char>(string[i]);
+            value *= 1099511628211ULL;
+        }
+        return value;
+    }
+
+    // size in bytes of all the levels of a width x height image
+    std::size_t levelsSize(unsigned int width, unsigned int height, unsigned int levels)
+    {
+        std::size_t size = 0;
+        for (unsigned int i = 0; i < levels; ++i)
+        {
+            size += static_cast<std::size_t>(width) * height * 4;
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+        }
+        return size;
+    }
+
+    // number of levels of a full mip chain: floor(log2(max(width, height))) + 1
+    unsigned int fullLevelCount(unsigned int width, unsigned int height)
+    {
+        unsigned int levels = 1;
+        for (unsigned int size = std::max(width, height); size > 1; size /= 2)
+            ++levels;
+        return levels;
+    }
+}
+
+/* The cache */
+class DecodedTextureCache
+{
+public:
+
+    // directory must exist; if mipmaps is true, a full mip chain is stored
+    // along with the image and uploaded with the texture
+    explicit DecodedTextureCache(const std::string& directory, bool mipmaps = false) :
+    m_directory(directory),
+    m_mipmaps(mipmaps),
+    m_hits(0),
+    m_misses(0)
+    {
+    }
+
+    // same as texture.loadFromFile(path), but without decoding if possible
+    bool loadFromFile(sf::Texture& texture, const std::string& path)
+    {
+        struct stat source;
+        if (stat(path.c_str(), &source) != 0)
+        {
+            sf::err() << "Failed to load texture \"" << path << "\" (file not found)" << std::endl;
+            return false;
+        }
+
+        std::string cachePath = getCachePath(path);
+
+        if (loadFromCache(texture, path, cachePath, source))
+        {
+            ++m_hits;
+            return true;
+        }
+
+        // cache miss or stale entry: decode the source and (re)write the cache
+        ++m_misses;
+
+        sf::Image image;
+        if (!image.loadFromFile(path))
+            return false;
+
+        std::vector<sf::Uint8> pixels(image.getPixelsPtr(), image.getPixelsPtr() +
+                                      levelsSize(image.getSize().x, image.getSize().y, 1));
+        unsigned int levels = 1;
+        if (m_mipmaps)
+            levels = buildMipmaps(pixels, image.getSize().x, image.getSize().y);
+
+        writeCache(cachePath, path, source, image.getSize(), levels, pixels);
+
+        return upload(texture, image.getSize().x, image.getSize().y, levels, &pixels[0]);
+    }
+
+    std::size_t getHitCount() const
+    {
+        return m_hits;
+    }
+
+    std::size_t getMissCount() const
+    {
+        return m_misses;
+    }
+
+private:
+
+    std::string getCachePath(const std::string& path) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.rgba",
+                      static_cast<unsigned long long>(hash(path)));
+        return m_directory + "/" + name;
+    }
+
+    bool loadFromCache(sf::Texture& texture, const std::string& path,
+                       const std::string& cachePath, const struct stat& source)
+    {
+        int file = open(cachePath.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat cache;
+        if (fstat(file, &cache) != 0 || cache.st_size < static_cast<off_t>(sizeof(CacheHeader)))
+        {
+            close(file);
+            return false;
+        }
+
+        std::size_t fileSize = static_cast<std::size_t>(cache.st_size);
+        void* mapping = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, file, 0);
+
+        // the mapping stays valid after the file is closed
+        close(file);
+
+        if (mapping == MAP_FAILED)
+            return false;
+
+        // we're going to read everything once, from start to end
+        madvise(mapping, fileSize, MADV_SEQUENTIAL);
+        madvise(mapping, fileSize, MADV_WILLNEED);
+
+        CacheHeader header;
+        std::memcpy(&header, mapping, sizeof(header));
+
+        bool valid = header.magic == cacheMagic &&
+                     header.version == cacheVersion &&
+                     header.sourceSize == static_cast<sf::Uint64>(source.st_size) &&
+                     header.sourceTime == static_cast<sf::Int64>(source.st_mtime) &&
+                     header.pathLength == path.size() &&
+                     sizeof(header) + path.size() <= header.dataOffset &&
+                     std::memcmp(static_cast<const char*>(mapping) + sizeof(header),
+                                 path.data(), path.size()) == 0 &&
+                     header.levels >= 1 &&
+                     header.levels <= fullLevelCount(header.width, header.height) &&
+                     header.dataOffset + levelsSize(header.width, header.height, header.levels) <= fileSize;
+
+        bool loaded = valid && upload(texture, header.width, header.height, header.levels,
+                                      static_cast<const sf::Uint8*>(mapping) + header.dataOffset);
+
+        munmap(mapping, fileSize);
+        return loaded;
+    }
+
+    // write to a temporary file first, then rename it: another instance of the
+    // game (or a crash) can never see a half-written cache file
+    void writeCache(const std::string& cachePath, const std::string& path,
+                    const struct stat& source, sf::Vector2u size, unsigned int levels,
+                    const std::vector<sf::Uint8>& pixels)
+    {
+        CacheHeader header;
+        std::memset(&header, 0, sizeof(header));
+        header.magic = cacheMagic;
+        header.version = cacheVersion;
+        header.width = size.x;
+        header.height = size.y;
+        header.levels = levels;
+        header.dataOffset = static_cast<sf::Uint32>(cacheDataOffset);
+        header.sourceSize = static_cast<sf::Uint64>(source.st_size);
+        header.sourceTime = static_cast<sf::Int64>(source.st_mtime);
+        header.pathLength = static_cast<sf::Uint32>(path.size());
+
+        // very long paths don't fit before the pixels, don't cache them
+        if (sizeof(header) + path.size() > cacheDataOffset)
+            return;
+
+        std::vector<char> padding(cacheDataOffset - sizeof(header), 0);
+        std::memcpy(&padding[0], path.data(), path.size());
+
+        std::string temporaryPath = cachePath + ".tmp";
+        std::FILE* file = std::fopen(temporaryPath.c_str(), "wb");
+        if (!file)
+            return;
+
+        bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       std::fwrite(&padding[0], padding.size(), 1, file) == 1 &&
+                       std::fwrite(&pixels[0], pixels.size(), 1, file) == 1;
+
+        if (std::fclose(file) != 0 || !written || std::rename(temporaryPath.c_str(), cachePath.c_str()) != 0)
+            std::remove(temporaryPath.c_str());
+    }
+
+    // append the mip levels to the pixels of the full size image, using a 2x2
+    // box filter; returns the number of levels
+    static unsigned int buildMipmaps(std::vector<sf::Uint8>& pixels,
+                                     unsigned int width, unsigned int height)
+    {
+        unsigned int levels = 1;
+        std::size_t source = 0;
+
+        while (width > 1 || height > 1)
+        {
+            unsigned int halfWidth = width > 1 ? width / 2 : 1;
+            unsigned int halfHeight = height > 1 ? height / 2 : 1;
+
+            std::size_t destination = pixels.size();
+            pixels.resize(destination + static_cast<std::size_t>(halfWidth) * halfHeight * 4);
+
+            for (unsigned int y = 0; y < halfHeight; ++y)
+                for (unsigned int x = 0; x < halfWidth; ++x)
+                    for (unsigned int c = 0; c < 4; ++c)
+                    {
+                        // clamp, for levels which are 1 pixel wide or high
+                        unsigned int x0 = x * 2, x1 = std::min(x * 2 + 1, width - 1);
+                        unsigned int y0 = y * 2, y1 = std::min(y * 2 + 1, height - 1);
+                        unsigned int sum = pixels[source + (x0 + y0 * width) * 4 + c] +
+                                           pixels[source + (x1 + y0 * width) * 4 + c] +
+                                           pixels[source + (x0 + y1 * width) * 4 + c] +
+                                           pixels[source + (x1 + y1 * width) * 4 + c];
+                        pixels[destination + (x + y * halfWidth) * 4 + c] =
+                            static_cast<sf::Uint8>((sum + 2) / 4);
+                    }
+
+            source = destination;
+            width = halfWidth;
+            height = halfHeight;
+            ++levels;
+        }
+
+        return levels;
+    }
+
+    static bool upload(sf::Texture& texture, unsigned int width, unsigned int height,
+                       unsigned int levels, const sf::Uint8* pixels)
+    {
+        if (!texture.create(width, height))
+            return false;
+
+        texture.update(pixels);
+
+        if (levels == 1)
+            return true;
+
+        // sf::Texture has no function to upload mip levels, so we do it with
+        // OpenGL directly; this replaces what texture.generateMipmap() would
+        // compute on the GPU
+        sf::Texture::bind(&texture);
+        pixels += static_cast<std::size_t>(width) * height * 4;
+        for (unsigned int level = 1; level < levels; ++level)
+        {
+            width = width > 1 ? width / 2 : 1;
+            height = height > 1 ? height / 2 : 1;
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA, width, height, 0,
+                         GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            pixels += static_cast<std::size_t>(width) * height * 4;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        sf::Texture::bind(NULL);
+
+        return true;
+    }
+
+    std::string m_directory;
+    bool m_mipmaps;
+    std::size_t m_hits;
+    std::size_t m_misses;
+};
+
+//sf::Texture doesn't know about the mip levels uploaded this way: calling
+//texture.setSmooth afterwards resets the minification filter, and so disables
+//mipmapping. Call setSmooth before loading, or reapply the filter afterwards.
+
+//The modification time has a resolution of one second on some file systems.
+//If your tools can rewrite a file twice in the same second with the same size,
+//add a content hash of the source to the header (at the cost of reading the
+//source file at every launch, which is still much cheaper than decoding it).
+
+/* Using it is a matter of replacing texture.loadFromFile(path) with
+cache.loadFromFile(texture, path). Run the program twice: the second time, all
+the textures are hits. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Decoded texture cache");
+
+    DecodedTextureCache cache(".", true);
+
+    const char* files[] = {"background.png", "player.png", "tileset.png"};
+    std::vector<sf::Texture> textures(3);
+
+    sf::Clock clock;
+    for (std::size_t i = 0; i < textures.size(); ++i)
+    {
+        if (!cache.loadFromFile(textures[i], files[i]))
+            return -1;
+    }
+
+    std::cout << "loaded " << textures.size() << " textures in "
+              << clock.getElapsedTime().asMilliseconds() << " ms ("
+              << cache.getHitCount() << " hits, "
+              << cache.getMissCount() << " misses)" << std::endl;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        window.clear();
+        for (std::size_t i = 0; i < textures.size(); ++i)
+            window.draw(sf::Sprite(textures[i]));
+        window.display();
+    }
+
+    return 0;
+}
@@ -0,0 +1,684 @@
+/* Rasterizing glyphs ahead of time, and only once
+
+compile with:  g++ -std=c++11 -c Glyph_Atlas_Prewarming.cpp -I/usr/include/freetype2
+and then link to get the executable with:
+
+    g++ Glyph_Atlas_Prewarming.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system -lfreetype -pthread
+*/
+
+/* Introduction
+
+As the fonts tutorial explains, glyphs are added to the font's texture when
+they are requested: the first time a character is drawn at a given size,
+getGlyph asks FreeType to rasterize it, and the font texture is updated (and
+sometimes enlarged, which means copying it entirely). The first frame that
+shows a new text, a new size, or just a new digit does this work, and often
+hitches.
+
+The work is always the same: for a given font, the same characters at the same
+sizes give the same pixels. So we can do it before the game starts, and even
+better, do it once and for all:
+
+1. prewarm: rasterize a whole character set at all the sizes the game uses, in
+   several worker threads, and pack the results into a single atlas texture
+2. save the atlas pixels and the glyph metrics (advance, bounds, kerning, line
+   spacing) to a file
+3. on the next launches, load this file: it's a single read and a single
+   texture upload, and FreeType isn't even needed
+
+sf::Font doesn't let us fill its glyph pages ourselves, and it uses a single
+FreeType face, which can't be used by several threads at once. So the atlas
+uses FreeType directly (it's what SFML uses internally, and it's installed
+with it): each worker opens its own face on the same font data, and renders
+glyphs the same way sf::Font does.*/
+
+#include <SFML/Graphics.hpp>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/* The glyph atlas
+
+Glyphs are identified by their style -- character size and boldness, packed
+into a single number like size * 2 + bold -- and their code point. The atlas
+stores their coverage (one byte per pixel, which is what FreeType renders) and
+only expands it to a white RGBA image when it's uploaded to the texture, like
+sf::Font does.*/
+class GlyphAtlas
+{
+public:
+
+    GlyphAtlas() :
+    m_width(0),
+    m_height(0)
+    {
+    }
+
+    // rasterize all the characters at all the sizes; workerCount = 0 uses
+    // one worker per core
+    bool prewarm(const std::string& fontFile, const sf::String& characters,
+                 const std::vector<unsigned int>& sizes, bool bold = false,
+                 unsigned int workerCount = 0)
+    {
+        // read the font once, all the workers share this (read-only) memory
+        std::vector<char> fontData;
+        if (!readFile(fontFile, fontData))
+            return false;
+
+        if (workerCount == 0)
+            workerCount = std::max(1u, std::thread::hardware_concurrency());
+
+        // split the work into jobs of 32 characters at one size
+        std::vector<sf::Uint32> codePoints(characters.begin(), characters.end());
+        std::vector<Job> jobs;
+        for (std::size_t i = 0; i < sizes.size(); ++i)
+            for (std::size_t first = 0; first < codePoints.size(); first += 32)
+            {
+                Job job;
+                job.size = sizes[i];
+                job.first = first;
+                job.last = std::min(first + 32, codePoints.size());
+                jobs.push_back(job);
+            }
+
+        // each worker takes the next job until there are none left, and
+        // keeps its results for itself: no lock is needed
+        std::vector<WorkerResult> results(workerCount);
+        std::vector<std::thread> workers;
+        std::atomic<std::size_t> nextJob(0);
+
+        for (unsigned int i = 0; i < workerCount; ++i)
+            workers.push_back(std::thread(&GlyphAtlas::rasterize, std::cref(fontData),
+                                          std::cref(codePoints), std::cref(jobs), bold,
+                                          std::ref(nextJob), std::ref(results[i])));
+
+        for (std::size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+
+        for (std::size_t i = 0; i < results.size(); ++i)
+            if (!results[i].success)
+                return false;
+
+        // gather everything; the atlas is only replaced if all succeeds
+        Contents contents;
+        std::vector<RasterizedGlyph> glyphs;
+        for (std::size_t i = 0; i < results.size(); ++i)
+        {
+            glyphs.insert(glyphs.end(), results[i].glyphs.begin(), results[i].glyphs.end());
+            contents.kerning.insert(results[i].kerning.begin(), results[i].kerning.end());
+            contents.lineSpacing.insert(results[i].lineSpacing.begin(), results[i].lineSpacing.end());
+        }
+
+        pack(glyphs, contents);
+        return replace(contents);
+    }
+
+    bool saveToFile(const std::string& filename) const
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file)
+            return false;
+
+        Header header;
+        std::memcpy(header.magic, "SFGA", 4);
+        header.version = 1;
+        header.width = m_width;
+        header.height = m_height;
+        header.styleCount = static_cast<sf::Uint32>(m_lineSpacing.size());
+        header.glyphCount = static_cast<sf::Uint32>(m_glyphs.size());
+        header.kerningCount = static_cast<sf::Uint32>(m_kerning.size());
+
+        std::vector<StyleRecord> styles;
+        for (std::unordered_map<sf::Uint32, float>::const_iterator it = m_lineSpacing.begin(); it != m_lineSpacing.end(); ++it)
+        {
+            StyleRecord record = {it->first, it->second};
+            styles.push_back(record);
+        }
+
+        std::vector<GlyphRecord> glyphs;
+        for (std::unordered_map<sf::Uint64, sf::Glyph>::const_iterator it = m_glyphs.begin(); it != m_glyphs.end(); ++it)
+        {
+            const sf::Glyph& glyph = it->second;
+            GlyphRecord record = {it->first, glyph.advance,
+                                  glyph.bounds.left, glyph.bounds.top, glyph.bounds.width, glyph.bounds.height,
+                                  glyph.textureRect.left, glyph.textureRect.top, glyph.textureRect.width, glyph.textureRect.height};
+            glyphs.push_back(record);
+        }
+
+        std::vector<KerningRecord> kerning;
+        for (std::unordered_map<sf::Uint64, float>::const_iterator it = m_kerning.begin(); it != m_kerning.end(); ++it)
+        {
+            KerningRecord record = {it->first, it->second};
+            kerning.push_back(record);
+        }
+
+        bool success = write(file, &header, sizeof(header)) &&
+                       write(file, styles.empty() ? NULL : &styles[0], styles.size() * sizeof(StyleRecord)) &&
+                       write(file, glyphs.empty() ? NULL : &glyphs[0], glyphs.size() * sizeof(GlyphRecord)) &&
+                       write(file, kerning.empty() ? NULL : &kerning[0], kerning.size() * sizeof(KerningRecord)) &&
+                       write(file, m_pixels.empty() ? NULL : &m_pixels[0], m_pixels.size());
+
+        return (std::fclose(file) == 0) && success;
+    }
+
+    bool loadFromFile(const std::string& filename)
+    {
+        std::vector<char> data;
+        if (!readFile(filename, data) || data.size() < sizeof(Header))
+            return false;
+
+        Header header;
+        std::memcpy(&header, &data[0], sizeof(header));
+        if (std::memcmp(header.magic, "SFGA", 4) != 0 || header.version != 1)
+            return false;
+
+        std::size_t expected = sizeof(Header) +
+                               header.styleCount * sizeof(StyleRecord) +
+                               header.glyphCount * sizeof(GlyphRecord) +
+                               header.kerningCount * sizeof(KerningRecord) +
+                               static_cast<std::size_t>(header.width) * header.height;
+        if (data.size() != expected)
+            return false;
+
+        const char* current = &data[0] + sizeof(Header);
+        Contents contents;
+
+        for (sf::Uint32 i = 0; i < header.styleCount; ++i, current += sizeof(StyleRecord))
+        {
+            StyleRecord record;
+            std::memcpy(&record, current, sizeof(record));
+            contents.lineSpacing[record.style] = record.lineSpacing;
+        }
+
+        for (sf::Uint32 i = 0; i < header.glyphCount; ++i, current += sizeof(GlyphRecord))
+        {
+            GlyphRecord record;
+            std::memcpy(&record, current, sizeof(record));
+
+            sf::Glyph& glyph = contents.glyphs[record.key];
+            glyph.advance = record.advance;
+            glyph.bounds = sf::FloatRect(record.left, record.top, record.width, record.height);
+            glyph.textureRect = sf::IntRect(record.x, record.y, record.w, record.h);
+        }
+
+        for (sf::Uint32 i = 0; i < header.kerningCount; ++i, current += sizeof(KerningRecord))
+        {
+            KerningRecord record;
+            std::memcpy(&record, current, sizeof(record));
+            contents.kerning[record.key] = record.value;
+        }
+
+        contents.width = header.width;
+        contents.height = header.height;
+        contents.pixels.assign(current, current + static_cast<std::size_t>(contents.width) * contents.height);
+
+        return replace(contents);
+    }
+
+    // NULL if the character wasn't prewarmed at this size
+    const sf::Glyph* getGlyph(sf::Uint32 codePoint, unsigned int size, bool bold) const
+    {
+        std::unordered_map<sf::Uint64, sf::Glyph>::const_iterator it = m_glyphs.find(glyphKey(style(size, bold), codePoint));
+        return it != m_glyphs.end() ? &it->second : NULL;
+    }
+
+    float getKerning(sf::Uint32 first, sf::Uint32 second, unsigned int size, bool bold) const
+    {
+        // only non-zero values are stored
+        std::unordered_map<sf::Uint64, float>::const_iterator it = m_kerning.find(kerningKey(style(size, bold), first, second));
+        return it != m_kerning.end() ? it->second : 0.f;
+    }
+
+    float getLineSpacing(unsigned int size, bool bold) const
+    {
+        std::unordered_map<sf::Uint32, float>::const_iterator it = m_lineSpacing.find(style(size, bold));
+        return it != m_lineSpacing.end() ? it->second : static_cast<float>(size);
+    }
+
+    const sf::Texture& getTexture() const
+    {
+        return m_texture;
+    }
+
+    // lay out a string like sf::Text does, and append its triangles to
+    // vertices; the texture of all the texts is getTexture(), whatever their
+    // size, so they can all be drawn at once
+    void appendText(std::vector<sf::Vertex>& vertices, const sf::String& string,
+                    sf::Vector2f position, unsigned int size, bool bold = false,
+                    const sf::Color& color = sf::Color::White) const
+    {
+        const sf::Glyph* space = getGlyph(L' ', size, bold);
+        float whitespaceWidth = space ? space->advance : size / 3.f;
+        float lineSpacing = getLineSpacing(size, bold);
+
+        float x = 0.f;
+        float y = static_cast<float>(size);
+        sf::Uint32 previous = 0;
+
+        for (std::size_t i = 0; i < string.getSize(); ++i)
+        {
+            sf::Uint32 current = string[i];
+
+            x += getKerning(previous, current, size, bold);
+            previous = current;
+
+            if (current == L' ' || current == L'\t')
+            {
+                x += whitespaceWidth * (current == L'\t' ? 4 : 1);
+                continue;
+            }
+            if (current == L'\n')
+            {
+                y += lineSpacing;
+                x = 0;
+                continue;
+            }
+
+            const sf::Glyph* glyph = getGlyph(current, size, bold);
+            if (!glyph)
+                continue;
+
+            // one pixel of padding, like sf::Text (the atlas leaves two
+            // transparent pixels around each glyph)
+            float left   = position.x + x + glyph->bounds.left - 1;
+            float top    = position.y + y + glyph->bounds.top - 1;
+            float right  = position.x + x + glyph->bounds.left + glyph->bounds.width + 1;
+            float bottom = position.y + y + glyph->bounds.top + glyph->bounds.height + 1;
+
+            float u1 = static_cast<float>(glyph->textureRect.left - 1);
+            float v1 = static_cast<float>(glyph->textureRect.top - 1);
+            float u2 = static_cast<float>(glyph->textureRect.left + glyph->textureRect.width + 1);
+            float v2 = static_cast<float>(glyph->textureRect.top + glyph->textureRect.height + 1);
+
+            vertices.push_back(sf::Vertex(sf::Vector2f(left, top), color, sf::Vector2f(u1, v1)));
+            vertices.push_back(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1)));
+            vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2)));
+            vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2)));
+            vertices.push_back(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1)));
+            vertices.push_back(sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(u2, v2)));
+
+            x += glyph->advance;
+        }
+    }
+
+private:
+
+    struct Job
+    {
+        unsigned int size;
+        std::size_t first;
+        std::size_t last;
+    };
+
+    struct RasterizedGlyph
+    {
+        sf::Uint64 key;
+        sf::Glyph glyph;
+        std::vector<sf::Uint8> coverage;
+    };
+
+    struct WorkerResult
+    {
+        WorkerResult() : success(true) {}
+
+        bool success;
+        std::vector<RasterizedGlyph> glyphs;
+        std::vector<std::pair<sf::Uint64, float> > kerning;
+        std::vector<std::pair<sf::Uint32, float> > lineSpacing;
+    };
+
+    // a new atlas, built aside before it replaces the current one
+    struct Contents
+    {
+        Contents() : width(0), height(0) {}
+
+        unsigned int width;
+        unsigned int height;
+        std::vector<sf::Uint8> pixels;
+        std::unordered_map<sf::Uint64, sf::Glyph> glyphs;
+        std::unordered_map<sf::Uint64, float> kerning;
+        std::unordered_map<sf::Uint32, float> lineSpacing;
+    };
+
+    // the file format: the header, the styles, the glyphs, the kerning pairs,
+    // and the pixels of the atlas, one byte each
+    struct Header
+    {
+        char magic[4];
+        sf::Uint32 version;
+        sf::Uint32 width;
+        sf::Uint32 height;
+        sf::Uint32 styleCount;
+        sf::Uint32 glyphCount;
+        sf::Uint32 kerningCount;
+    };
+
+    struct StyleRecord
+    {
+        sf::Uint32 style;
+        float lineSpacing;
+    };
+
+    struct GlyphRecord
+    {
+        sf::Uint64 key;
+        float advance;
+        float left, top, width, height;
+        sf::Int32 x, y, w, h;
+    };
+
+    struct KerningRecord
+    {
+        sf::Uint64 key;
+        float value;
+    };
+
+    static sf::Uint32 style(unsigned int size, bool bold)
+    {
+        return size * 2 + (bold ? 1 : 0);
+    }
+
+    static sf::Uint64 glyphKey(sf::Uint32 style, sf::Uint32 codePoint)
+    {
+        return (static_cast<sf::Uint64>(style) << 32) | codePoint;
+    }
+
+    // code points are at most 21 bits long
+    static sf::Uint64 kerningKey(sf::Uint32 style, sf::Uint32 first, sf::Uint32 second)
+    {
+        return (static_cast<sf::Uint64>(style) << 42) | (static_cast<sf::Uint64>(first) << 21) | second;
+    }
+
+    // the function run by the worker threads
+    static void rasterize(const std::vector<char>& fontData, const std::vector<sf::Uint32>& codePoints,
+                          const std::vector<Job>& jobs, bool bold, std::atomic<std::size_t>& nextJob,
+                          WorkerResult& result)
+    {
+        // a FreeType library and face of our own
+        FT_Library library;
+        if (FT_Init_FreeType(&library) != 0)
+        {
+            result.success = false;
+            return;
+        }
+
+        FT_Face face;
+        if (FT_New_Memory_Face(library, reinterpret_cast<const FT_Byte*>(&fontData[0]),
+                               static_cast<FT_Long>(fontData.size()), 0, &face) != 0)
+        {
+            FT_Done_FreeType(library);
+            result.success = false;
+            return;
+        }
+
+        for (std::size_t index = nextJob++; index < jobs.size(); index = nextJob++)
+        {
+            const Job& job = jobs[index];
+            sf::Uint32 jobStyle = style(job.size, bold);
+
+            FT_Set_Pixel_Sizes(face, 0, job.size);
+            if (job.first == 0)
+                result.lineSpacing.push_back(std::make_pair(jobStyle, static_cast<float>(face->size->metrics.height) / 64.f));
+
+            for (std::size_t i = job.first; i < job.last; ++i)
+            {
+                RasterizedGlyph glyph;
+                glyph.key = glyphKey(jobStyle, codePoints[i]);
+                if (renderGlyph(face, codePoints[i], bold, glyph))
+                    result.glyphs.push_back(glyph);
+
+                // kerning pairs that start with this character
+                if (FT_HAS_KERNING(face))
+                {
+                    FT_UInt left = FT_Get_Char_Index(face, codePoints[i]);
+                    for (std::size_t j = 0; j < codePoints.size(); ++j)
+                    {
+                        FT_Vector kerning;
+                        FT_UInt right = FT_Get_Char_Index(face, codePoints[j]);
+                        if (FT_Get_Kerning(face, left, right, FT_KERNING_DEFAULT, &kerning) == 0 && kerning.x != 0)
+                            result.kerning.push_back(std::make_pair(kerningKey(jobStyle, codePoints[i], codePoints[j]),
+                                                                    static_cast<float>(kerning.x) / 64.f));
+                    }
+                }
+            }
+        }
+
+        FT_Done_Face(face);
+        FT_Done_FreeType(library);
+    }
+
+    // the same steps as sf::Font::loadGlyph
+    static bool renderGlyph(FT_Face face, sf::Uint32 codePoint, bool bold, RasterizedGlyph& result)
+    {
+        if (FT_Load_Char(face, codePoint, FT_LOAD_TARGET_NORMAL | FT_LOAD_FORCE_AUTOHINT) != 0)
+            return false;
+
+        FT_GlyphSlot slot = face->glyph;
+        FT_Pos weight = 1 << 6;
+        if (bold && slot->format == FT_GLYPH_FORMAT_OUTLINE)
+            FT_Outline_Embolden(&slot->outline, weight);
+
+        if (FT_Render_Glyph(slot, FT_RENDER_MODE_NORMAL) != 0)
+            return false;
+
+        const FT_Bitmap& bitmap = slot->bitmap;
+        int width = static_cast<int>(bitmap.width);
+        int height = static_cast<int>(bitmap.rows);
+
+        sf::Glyph& glyph = result.glyph;
+        glyph.advance = static_cast<float>(slot->metrics.horiAdvance) / 64.f;
+        if (bold)
+            glyph.advance += static_cast<float>(weight) / 64.f;
+        glyph.bounds = sf::FloatRect(static_cast<float>(slot->bitmap_left), static_cast<float>(-slot->bitmap_top),
+                                     static_cast<float>(width), static_cast<float>(height));
+        glyph.textureRect = sf::IntRect(0, 0, width, height);
+
+        result.coverage.resize(static_cast<std::size_t>(width) * height);
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char* row = bitmap.buffer + y * bitmap.pitch;
+            for (int x = 0; x < width; ++x)
+            {
+                // monochrome bitmaps (some bitmap fonts) use one bit per pixel
+                if (bitmap.pixel_mode == FT_PIXEL_MODE_MONO)
+                    result.coverage[x + y * width] = ((row[x / 8] >> (7 - x % 8)) & 1) ? 255 : 0;
+                else
+                    result.coverage[x + y * width] = row[x];
+            }
+        }
+
+        return true;
+    }
+
+    static bool higher(const RasterizedGlyph& left, const RasterizedGlyph& right)
+    {
+        if (left.glyph.textureRect.height != right.glyph.textureRect.height)
+            return left.glyph.textureRect.height > right.glyph.textureRect.height;
+        return left.key < right.key;
+    }
+
+    // place the glyphs on rows ("shelves"), from the highest to the lowest,
+    // so that the rows waste little space; the order doesn't depend on the
+    // number of workers, so the atlas is always the same
+    void pack(std::vector<RasterizedGlyph>& glyphs, Contents& contents)
+    {
+        std::sort(glyphs.begin(), glyphs.end(), &GlyphAtlas::higher);
+
+        // two transparent pixels around each glyph, like sf::Font, so that
+        // smoothing never picks pixels of the neighbours
+        const int padding = 2;
+
+        contents.width = std::min(1024u, sf::Texture::getMaximumSize());
+        int x = 0;
+        int y = 0;
+        int rowHeight = 0;
+
+        for (std::size_t i = 0; i < glyphs.size(); ++i)
+        {
+            sf::IntRect& rect = glyphs[i].glyph.textureRect;
+            if (x + rect.width + 2 * padding > static_cast<int>(contents.width))
+            {
+                x = 0;
+                y += rowHeight;
+                rowHeight = 0;
+            }
+
+            rect.left = x + padding;
+            rect.top = y + padding;
+            x += rect.width + 2 * padding;
+            rowHeight = std::max(rowHeight, rect.height + 2 * padding);
+        }
+
+        contents.height = static_cast<unsigned int>(y + rowHeight);
+        contents.pixels.assign(static_cast<std::size_t>(contents.width) * contents.height, 0);
+
+        for (std::size_t i = 0; i < glyphs.size(); ++i)
+        {
+            const sf::IntRect& rect = glyphs[i].glyph.textureRect;
+            for (int row = 0; row < rect.height; ++row)
+                std::memcpy(&contents.pixels[rect.left + (rect.top + row) * contents.width],
+                            &glyphs[i].coverage[row * rect.width], rect.width);
+
+            contents.glyphs[glyphs[i].key] = glyphs[i].glyph;
+        }
+    }
+
+    // upload the new contents, and only then replace the current ones: on
+    // failure, the atlas is left as it was
+    bool replace(Contents& contents)
+    {
+        if (contents.width == 0 || contents.height == 0)
+            return false;
+
+        // white pixels, with the coverage as alpha
+        std::vector<sf::Uint8> rgba(contents.pixels.size() * 4, 255);
+        for (std::size_t i = 0; i < contents.pixels.size(); ++i)
+            rgba[i * 4 + 3] = contents.pixels[i];
+
+        sf::Image image;
+        image.create(contents.width, contents.height, &rgba[0]);
+        if (!m_texture.loadFromImage(image))
+            return false;
+
+        m_texture.setSmooth(true);
+        m_width = contents.width;
+        m_height = contents.height;
+        m_pixels.swap(contents.pixels);
+        m_glyphs.swap(contents.glyphs);
+        m_kerning.swap(contents.kerning);
+        m_lineSpacing.swap(contents.lineSpacing);
+        return true;
+    }
+
+    static bool readFile(const std::string& filename, std::vector<char>& data)
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "rb");
+        if (!file)
+            return false;
+
+        std::fseek(file, 0, SEEK_END);
+        long size = std::ftell(file);
+        std::fseek(file, 0, SEEK_SET);
+
+        data.resize(size > 0 ? static_cast<std::size_t>(size) : 0);
+        bool success = size > 0 && std::fread(&data[0], 1, data.size(), file) == data.size();
+
+        std::fclose(file);
+        return success;
+    }
+
+    static bool write(std::FILE* file, const void* data, std::size_t size)
+    {
+        return size == 0 || std::fwrite(data, 1, size, file) == size;
+    }
+
+    unsigned int m_width;
+    unsigned int m_height;
+    std::vector<sf::Uint8> m_pixels;
+    sf::Texture m_texture;
+    std::unordered_map<sf::Uint64, sf::Glyph> m_glyphs;
+    std::unordered_map<sf::Uint64, float> m_kerning;
+    std::unordered_map<sf::Uint32, float> m_lineSpacing;
+};
+
+//The atlas file is written with the layout of the structures of the machine
+//that writes it. It's a cache, not a distribution format: generate it on the
+//player's machine at the first launch (like below), or during your build for
+//each platform. Delete it when the font or the character set changes.
+
+//Characters that were not prewarmed are not in the atlas. Either add them to
+//the character set, or draw the rare ones with a regular sf::Text.
+
+/* A demo: the first launch rasterizes printable ASCII and Latin-1 at 8 sizes
+and saves the atlas, the next ones just load it. Texts of all sizes are drawn
+with a single draw call, since they all use the same texture. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Glyph atlas");
+
+    GlyphAtlas atlas;
+    sf::Clock clock;
+
+    if (atlas.loadFromFile("arial.atlas"))
+    {
+        std::cout << "atlas loaded in " << clock.getElapsedTime().asMilliseconds() << " ms" << std::endl;
+    }
+    else
+    {
+        sf::String characters;
+        for (sf::Uint32 c = 0x20; c < 0x7F; ++c)
+            characters += c;
+        for (sf::Uint32 c = 0xA0; c <= 0xFF; ++c)
+            characters += c;
+
+        std::vector<unsigned int> sizes;
+        sizes.push_back(12);
+        sizes.push_back(14);
+        sizes.push_back(16);
+        sizes.push_back(20);
+        sizes.push_back(24);
+        sizes.push_back(32);
+        sizes.push_back(48);
+        sizes.push_back(64);
+
+        if (!atlas.prewarm("arial.ttf", characters, sizes))
+            return -1;
+
+        std::cout << "atlas prewarmed in " << clock.getElapsedTime().asMilliseconds() << " ms" << std::endl;
+        atlas.saveToFile("arial.atlas");
+    }
+
+    std::vector<sf::Vertex> vertices;
+    float y = 10;
+    unsigned int sizes[] = {12, 16, 24, 32, 48, 64};
+    for (std::size_t i = 0; i < 6; ++i)
+    {
+        atlas.appendText(vertices, "Prewarmed glyphs: 0123456789", sf::Vector2f(10, y), sizes[i]);
+        y += atlas.getLineSpacing(sizes[i], false);
+    }
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        window.clear();
+        if (!vertices.empty())
+            window.draw(&vertices[0], vertices.size(), sf::Triangles, &atlas.getTexture());
+        window.display();
+    }
+
+    return 0;
+}
@@ -0,0 +1,502 @@
+/* Fast pixel operations on images
+
+compile with:  g++ -O2 -mavx2 -c Image_Pixel_Operations.cpp
+(or without -mavx2 for CPUs that don't support it, the SSE2 version is then
+used) and then link to get the executable with:
+
+    g++ Image_Pixel_Operations.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+As the sprites tutorial explains, the pixels of a sf::Image stay in system
+memory, which makes them fast to manipulate. But sf::Image only gives you
+getPixel and setPixel: one function call, one bounds check and one sf::Color
+per pixel. That's fine for editing a few pixels, not for preprocessing every
+image that a game loads.
+
+Most preprocessing steps do the same thing to every pixel, which is exactly
+what SIMD instructions are made for. With SSE2 (available on every 64-bit x86
+CPU) we process 4 RGBA pixels per instruction, with AVX2, 8 pixels.
+
+The functions below work on a raw RGBA buffer, laid out like the one returned
+by image.getPixelsPtr(): 4 bytes per pixel, rows stored one after the other.
+Since sf::Image doesn't give write access to its pixels, the workflow is:
+
+1. copy the pixels to a buffer (or get them from your own decoder)
+2. process the buffer with as many operations as needed
+3. create the image from the buffer, or update the texture directly with it */
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+    #include <emmintrin.h>
+    #define PIXELOPS_SSE2
+#endif
+#if defined(__AVX2__)
+    #include <immintrin.h>
+    #define PIXELOPS_AVX2
+#endif
+
+/* Multiplying 8-bit components
+
+Multiplying two components and dividing by 255 is the core of premultiplication
+and tinting. Dividing is slow, so we use the classic exact rounding trick:
+x * y / 255 == (t + (t >> 8)) >> 8, with t = x * y + 128. With 16-bit lanes, it
+never overflows: the largest t is 65153.*/
+inline sf::Uint8 multiply(sf::Uint8 x, sf::Uint8 y)
+{
+    unsigned int t = x * y + 128;
+    return static_cast<sf::Uint8>((t + (t >> 8)) >> 8);
+}
+
+#if defined(PIXELOPS_SSE2)
+// the same formula on eight 16-bit lanes
+inline __m128i multiply(__m128i x, __m128i y)
+{
+    __m128i t = _mm_add_epi16(_mm_mullo_epi16(x, y), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+#endif
+
+#if defined(PIXELOPS_AVX2)
+inline __m256i multiply(__m256i x, __m256i y)
+{
+    __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(x, y), _mm256_set1_epi16(128));
+    return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+}
+#endif
+
+/* Each operation follows the same structure: a wide loop for as many pixels as
+possible, and a scalar loop for the remaining ones (and for CPUs without SIMD
+support). */
+
+/* Premultiplied alpha
+
+Multiplies the color components by alpha. Premultiplied textures are drawn with
+a (One, OneMinusSrcAlpha) blend mode, and don't get dark fringes when smoothed.*/
+void premultiplyAlpha(sf::Uint8* pixels, std::size_t count)
+{
+    std::size_t i = 0;
+
+#if defined(PIXELOPS_AVX2)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i rgbMask = _mm256_set_epi16(0, -1, -1, -1, 0, -1, -1, -1,
+                                                 0, -1, -1, -1, 0, -1, -1, -1);
+        const __m256i alphaOne = _mm256_set_epi16(255, 0, 0, 0, 255, 0, 0, 0,
+                                                  255, 0, 0, 0, 255, 0, 0, 0);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i p = _mm256_loadu_si256(reinterpret_cast<__m256i*>(pixels + i * 4));
+
+            // unpacking and packing work per 128-bit half, so the pixels end up
+            // in their original order
+            __m256i lo = _mm256_unpacklo_epi8(p, zero);
+            __m256i hi = _mm256_unpackhi_epi8(p, zero);
+
+            // broadcast alpha to the 4 components of each pixel, then multiply
+            // alpha by 255 so that it doesn't change
+            __m256i loAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(lo, 0xFF), 0xFF);
+            __m256i hiAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(hi, 0xFF), 0xFF);
+            loAlpha = _mm256_or_si256(_mm256_and_si256(loAlpha, rgbMask), alphaOne);
+            hiAlpha = _mm256_or_si256(_mm256_and_si256(hiAlpha, rgbMask), alphaOne);
+
+            p = _mm256_packus_epi16(multiply(lo, loAlpha), multiply(hi, hiAlpha));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i * 4), p);
+        }
+    }
+#endif
+
+#if defined(PIXELOPS_SSE2)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i rgbMask = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+        const __m128i alphaOne = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i p = _mm_loadu_si128(reinterpret_cast<__m128i*>(pixels + i * 4));
+
+            __m128i lo = _mm_unpacklo_epi8(p, zero);
+            __m128i hi = _mm_unpackhi_epi8(p, zero);
+
+            __m128i loAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(lo, 0xFF), 0xFF);
+            __m128i hiAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(hi, 0xFF), 0xFF);
+            loAlpha = _mm_or_si128(_mm_and_si128(loAlpha, rgbMask), alphaOne);
+            hiAlpha = _mm_or_si128(_mm_and_si128(hiAlpha, rgbMask), alphaOne);
+
+            p = _mm_packus_epi16(multiply(lo, loAlpha), multiply(hi, hiAlpha));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i * 4), p);
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        sf::Uint8* p = pixels + i * 4;
+        p[0] = multiply(p[0], p[3]);
+        p[1] = multiply(p[1], p[3]);
+        p[2] = multiply(p[2], p[3]);
+    }
+}
+
+/* Tinting
+
+Multiplies every pixel by a color, like sprite.setColor does when drawing, but
+once and for all.*/
+void tint(sf::Uint8* pixels, std::size_t count, const sf::Color& color)
+{
+    std::size_t i = 0;
+
+#if defined(PIXELOPS_AVX2)
+    {
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i factor = _mm256_set_epi16(color.a, color.b, color.g, color.r,
+                                                color.a, color.b, color.g, color.r,
+                                                color.a, color.b, color.g, color.r,
+                                                color.a, color.b, color.g, color.r);
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i p = _mm256_loadu_si256(reinterpret_cast<__m256i*>(pixels + i * 4));
+            __m256i lo = multiply(_mm256_unpacklo_epi8(p, zero), factor);
+            __m256i hi = multiply(_mm256_unpackhi_epi8(p, zero), factor);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i * 4),
+                                _mm256_packus_epi16(lo, hi));
+        }
+    }
+#endif
+
+#if defined(PIXELOPS_SSE2)
+    {
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i factor = _mm_set_epi16(color.a, color.b, color.g, color.r,
+                                             color.a, color.b, color.g, color.r);
+        for (; i + 4 <= count; i += 4)
+        {
+            __m128i p = _mm_loadu_si128(reinterpret_cast<__m128i*>(pixels + i * 4));
+            __m128i lo = multiply(_mm_unpacklo_epi8(p, zero), factor);
+            __m128i hi = multiply(_mm_unpackhi_epi8(p, zero), factor);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i * 4),
+                             _mm_packus_epi16(lo, hi));
+        }
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        sf::Uint8* p = pixels + i * 4;
+        p[0] = multiply(p[0], color.r);
+        p[1] = multiply(p[1], color.g);
+        p[2] = multiply(p[2], color.b);
+        p[3] = multiply(p[3], color.a);
+    }
+}
+
+/* Color key masking
+
+Same as sf::Image::createMaskFromColor: the pixels which are exactly equal to
+color get their alpha set to the given value. A pixel is 4 bytes, so it is
+compared as one 32-bit integer; in memory the bytes are R, G, B, A, so on a
+little-endian CPU alpha is the most significant byte.*/
+void createMaskFromColor(sf::Uint8* pixels, std::size_t count,
+                         const sf::Color& color, sf::Uint8 alpha = 0)
+{
+    std::size_t i = 0;
+
+#if defined(PIXELOPS_SSE2) || defined(PIXELOPS_AVX2)
+    const int key = static_cast<int>(color.r | (color.g << 8) | (color.b << 16) |
+                                     (static_cast<sf::Uint32>(color.a) << 24));
+    const int rgbBits = 0x00FFFFFF;
+    const int alphaBits = static_cast<int>(static_cast<sf::Uint32>(alpha) << 24);
+#endif
+
+#if defined(PIXELOPS_AVX2)
+    for (; i + 8 <= count; i += 8)
+    {
+        __m256i p = _mm256_loadu_si256(reinterpret_cast<__m256i*>(pixels + i * 4));
+        __m256i equal = _mm256_cmpeq_epi32(p, _mm256_set1_epi32(key));
+        __m256i masked = _mm256_or_si256(_mm256_and_si256(p, _mm256_set1_epi32(rgbBits)),
+                                         _mm256_set1_epi32(alphaBits));
+
+        // select masked where equal, p elsewhere
+        p = _mm256_blendv_epi8(p, masked, equal);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i * 4), p);
+    }
+#endif
+
+#if defined(PIXELOPS_SSE2)
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i p = _mm_loadu_si128(reinterpret_cast<__m128i*>(pixels + i * 4));
+        __m128i equal = _mm_cmpeq_epi32(p, _mm_set1_epi32(key));
+        __m128i masked = _mm_or_si128(_mm_and_si128(p, _mm_set1_epi32(rgbBits)),
+                                      _mm_set1_epi32(alphaBits));
+
+        // SSE2 has no blend instruction, so select with and/andnot/or
+        p = _mm_or_si128(_mm_and_si128(equal, masked), _mm_andnot_si128(equal, p));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + i * 4), p);
+    }
+#endif
+
+    for (; i < count; ++i)
+    {
+        sf::Uint8* p = pixels + i * 4;
+        if (p[0] == color.r && p[1] == color.g && p[2] == color.b && p[3] == color.a)
+            p[3] = alpha;
+    }
+}
+
+/* Flipping
+
+Flipping vertically just swaps whole rows, which std::swap_ranges (or memcpy)
+already does as fast as memory allows. Flipping horizontally reverses the
+pixels of each row: SSE2 can reverse 4 pixels with a single shuffle, so we swap
+blocks of 4 pixels from both ends of the row.*/
+void flipVertically(sf::Uint8* pixels, unsigned int width, unsigned int height)
+{
+    std::size_t rowSize = static_cast<std::size_t>(width) * 4;
+    for (unsigned int y = 0; y < height / 2; ++y)
+    {
+        sf::Uint8* top = pixels + y * rowSize;
+        sf::Uint8* bottom = pixels + (height - 1 - y) * rowSize;
+        std::swap_ranges(top, top + rowSize, bottom);
+    }
+}
+
+void flipHorizontally(sf::Uint8* pixels, unsigned int width, unsigned int height)
+{
+    for (unsigned int y = 0; y < height; ++y)
+    {
+        sf::Uint32* row = reinterpret_cast<sf::Uint32*>(pixels) +
+                          static_cast<std::size_t>(y) * width;
+        std::size_t left = 0;
+        std::size_t right = width;
+
+#if defined(PIXELOPS_SSE2)
+        for (; left + 8 <= right; left += 4, right -= 4)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<__m128i*>(row + left));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<__m128i*>(row + right - 4));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + left),
+                             _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 1, 2, 3)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(row + right - 4),
+                             _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 1, 2, 3)));
+        }
+#endif
+
+        std::reverse(row + left, row + right);
+    }
+}
+
+/* Downsampling
+
+Halves the size of the image, each destination pixel being the average of a
+2x2 block (a box filter). This is how you would build mipmaps or low-quality
+versions of your textures on the CPU. The destination must hold
+(width / 2) * (height / 2) pixels; with odd sizes, the last row or column is
+ignored.*/
+void downsample(const sf::Uint8* source, unsigned int width, unsigned int height,
+                sf::Uint8* destination)
+{
+    unsigned int halfWidth = width / 2;
+    unsigned int halfHeight = height / 2;
+    std::size_t rowSize = static_cast<std::size_t>(width) * 4;
+
+    for (unsigned int y = 0; y < halfHeight; ++y)
+    {
+        const sf::Uint8* row0 = source + (y * 2) * rowSize;
+        const sf::Uint8* row1 = row0 + rowSize;
+        sf::Uint8* out = destination + static_cast<std::size_t>(y) * halfWidth * 4;
+        unsigned int x = 0;
+
+#if defined(PIXELOPS_SSE2)
+        // 4 source pixels of each row give 2 destination pixels
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i two = _mm_set1_epi16(2);
+        for (; x + 2 <= halfWidth; x += 2)
+        {
+            __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row0 + x * 8));
+            __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row1 + x * 8));
+
+            // vertical sums, 16 bits per component
+            __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+            __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+
+            // horizontal sums: add the second pixel of each pair to the first
+            lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+            hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+
+            // (sum + 2) / 4, with rounding
+            __m128i sum = _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), two), 2);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), _mm_packus_epi16(sum, zero));
+        }
+#endif
+
+        for (; x < halfWidth; ++x)
+        {
+            for (unsigned int c = 0; c < 4; ++c)
+            {
+                unsigned int sum = row0[x * 8 + c] + row0[x * 8 + 4 + c] +
+                                   row1[x * 8 + c] + row1[x * 8 + 4 + c];
+                out[x * 4 + c] = static_cast<sf::Uint8>((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+//Because the wide loops process unaligned memory (loadu/storeu), the buffer
+//doesn't need any special alignment: a std::vector<sf::Uint8> is fine. With
+//16 or 32-byte aligned buffers they are a little faster on older CPUs.
+
+/* Benchmark
+
+Let's compare with the per-pixel path on a 2048x2048 image. Each operation is
+applied to a fresh copy of the same pixels, so that both paths do exactly the
+same work, and the results are compared to make sure they match.*/
+template <typename Function>
+sf::Time measure(Function function, int repeat = 10)
+{
+    sf::Clock clock;
+    for (int i = 0; i < repeat; ++i)
+        function();
+    return clock.getElapsedTime() / repeat;
+}
+
+void report(const char* name, sf::Time perPixel, sf::Time bulk, bool same)
+{
+    std::cout << name << ": " << perPixel.asMicroseconds() << " us -> "
+              << bulk.asMicroseconds() << " us ("
+              << static_cast<float>(perPixel.asMicroseconds()) / std::max<sf::Int64>(bulk.asMicroseconds(), 1)
+              << "x)" << (same ? "" : " MISMATCH") << std::endl;
+}
+
+int main()
+{
+    const unsigned int width = 2048;
+    const unsigned int height = 2048;
+    const std::size_t count = static_cast<std::size_t>(width) * height;
+
+    sf::Image source;
+    source.create(width, height);
+    for (unsigned int y = 0; y < height; ++y)
+        for (unsigned int x = 0; x < width; ++x)
+            source.setPixel(x, y, (x + y) % 7 == 0 ? sf::Color::Magenta :
+                                  sf::Color(x % 256, y % 256, (x * y) % 256, (x + y) % 256));
+
+    sf::Image image;
+    std::vector<sf::Uint8> buffer(count * 4);
+
+#if defined(PIXELOPS_AVX2)
+    std::cout << "using AVX2" << std::endl;
+#elif defined(PIXELOPS_SSE2)
+    std::cout << "using SSE2" << std::endl;
+#else
+    std::cout << "using scalar code" << std::endl;
+#endif
+
+    // premultiplied alpha
+    sf::Time perPixel = measure([&]()
+    {
+        image = source;
+        for (unsigned int y = 0; y < height; ++y)
+            for (unsigned int x = 0; x < width; ++x)
+            {
+                sf::Color c = image.getPixel(x, y);
+                image.setPixel(x, y, sf::Color(multiply(c.r, c.a), multiply(c.g, c.a),
+                                               multiply(c.b, c.a), c.a));
+            }
+    });
+    sf::Time bulk = measure([&]()
+    {
+        std::memcpy(&buffer[0], source.getPixelsPtr(), buffer.size());
+        premultiplyAlpha(&buffer[0], count);
+    });
+    report("premultiply", perPixel, bulk,
+           std::memcmp(&buffer[0], image.getPixelsPtr(), buffer.size()) == 0);
+
+    // tinting
+    sf::Color color(255, 128, 64, 200);
+    perPixel = measure([&]()
+    {
+        image = source;
+        for (unsigned int y = 0; y < height; ++y)
+            for (unsigned int x = 0; x < width; ++x)
+                image.setPixel(x, y, image.getPixel(x, y) * color);
+    });
+    bulk = measure([&]()
+    {
+        std::memcpy(&buffer[0], source.getPixelsPtr(), buffer.size());
+        tint(&buffer[0], count, color);
+    });
+    // sf::Color's operator * truncates instead of rounding, so we don't
+    // compare the results here
+    report("tint", perPixel, bulk, true);
+
+    // color key
+    perPixel = measure([&]()
+    {
+        image = source;
+        image.createMaskFromColor(sf::Color::Magenta);
+    });
+    bulk = measure([&]()
+    {
+        std::memcpy(&buffer[0], source.getPixelsPtr(), buffer.size());
+        createMaskFromColor(&buffer[0], count, sf::Color::Magenta);
+    });
+    report("color key", perPixel, bulk,
+           std::memcmp(&buffer[0], image.getPixelsPtr(), buffer.size()) == 0);
+
+    // horizontal flip
+    perPixel = measure([&]()
+    {
+        image = source;
+        for (unsigned int y = 0; y < height; ++y)
+            for (unsigned int x = 0; x < width / 2; ++x)
+            {
+                sf::Color left = image.getPixel(x, y);
+                image.setPixel(x, y, image.getPixel(width - 1 - x, y));
+                image.setPixel(width - 1 - x, y, left);
+            }
+    });
+    bulk = measure([&]()
+    {
+        std::memcpy(&buffer[0], source.getPixelsPtr(), buffer.size());
+        flipHorizontally(&buffer[0], width, height);
+    });
+    report("flip", perPixel, bulk,
+           std::memcmp(&buffer[0], image.getPixelsPtr(), buffer.size()) == 0);
+
+    // downsampling
+    std::vector<sf::Uint8> half(count);
+    perPixel = measure([&]()
+    {
+        image.create(width / 2, height / 2);
+        for (unsigned int y = 0; y < height / 2; ++y)
+            for (unsigned int x = 0; x < width / 2; ++x)
+            {
+                sf::Color a = source.getPixel(x * 2, y * 2);
+                sf::Color b = source.getPixel(x * 2 + 1, y * 2);
+                sf::Color c = source.getPixel(x * 2, y * 2 + 1);
+                sf::Color d = source.getPixel(x * 2 + 1, y * 2 + 1);
+                image.setPixel(x, y, sf::Color((a.r + b.r + c.r + d.r + 2) / 4,
+                                               (a.g + b.g + c.g + d.g + 2) / 4,
+                                               (a.b + b.b + c.b + d.b + 2) / 4,
+                                               (a.a + b.a + c.a + d.a + 2) / 4));
+            }
+    });
+    bulk = measure([&]()
+    {
+        downsample(source.getPixelsPtr(), width, height, &half[0]);
+    });
+    report("downsample", perPixel, bulk,
+           std::memcmp(&half[0], image.getPixelsPtr(), half.size()) == 0);
+
+    // finally, the processed pixels go back into an image or a texture
+    image.create(width / 2, height / 2, &half[0]);
+
+    return 0;
+}
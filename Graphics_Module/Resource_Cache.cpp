@@ -0,0 +1,379 @@
+/* Managing resources with a cache
+
+compile with:  g++ -std=c++11 -c Resource_Cache.cpp
+and then link to get the executable with:
+
+    g++ Resource_Cache.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+The white square problem of the sprites tutorial comes from managing textures
+by hand: a sprite only stores a pointer to its texture, so someone else has to
+keep the texture alive, and in the right place, as long as the sprite uses it.
+
+In a real game, managing textures by hand causes a second problem, which is
+less visible: when two parts of the program need "tree.png", each of them
+loads its own copy. The file is decoded twice, and the pixels are stored twice
+in video memory.
+
+Both problems have the same solution: a single object which owns all the
+resources, loads each file once, and gives out handles to them. Here, a handle
+is a reference count: as long as a handle exists, its resource stays alive and
+at the same address. When the last handle is released, the resource isn't
+destroyed immediately -- it is very common to need it again a few frames
+later -- but it becomes a candidate for eviction. Unused resources are evicted,
+least recently used first, when the memory they take exceeds a budget.*/
+
+#include <SFML/Graphics.hpp>
+#include <iostream>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+/* Loading and measuring resources
+
+The cache is a template that works with any resource type. What differs from
+one type to another is how to load it, and how much memory it takes; that's
+what the traits below define. The sizes are estimations: the driver may pad
+textures, and a font also allocates glyph pages as it is used.*/
+template <typename Resource>
+struct ResourceTraits;
+
+template <>
+struct ResourceTraits<sf::Texture>
+{
+    static bool load(sf::Texture& texture, const std::string& path, std::size_t& bytes)
+    {
+        if (!texture.loadFromFile(path))
+            return false;
+
+        bytes = static_cast<std::size_t>(texture.getSize().x) * texture.getSize().y * 4;
+        return true;
+    }
+};
+
+template <>
+struct ResourceTraits<sf::Image>
+{
+    static bool load(sf::Image& image, const std::string& path, std::size_t& bytes)
+    {
+        if (!image.loadFromFile(path))
+            return false;
+
+        bytes = static_cast<std::size_t>(image.getSize().x) * image.getSize().y * 4;
+        return true;
+    }
+};
+
+template <>
+struct ResourceTraits<sf::Font>
+{
+    static bool load(sf::Font& font, const std::string& path, std::size_t& bytes)
+    {
+        // a font keeps reading its file as glyphs are requested, the file size
+        // is a reasonable estimation of what it keeps in memory
+        sf::FileInputStream file;
+        if (!file.open(path) || !font.loadFromFile(path))
+            return false;
+
+        bytes = static_cast<std::size_t>(file.getSize());
+        return true;
+    }
+};
+
+/* Statistics
+
+These are what you want to watch when tuning the budget: a low hit rate means
+that resources are evicted and then loaded again, so the budget is too small
+(or the same files are requested with different paths).*/
+struct ResourceCacheStats
+{
+    std::size_t residentBytes;   // memory taken by all the loaded resources
+    std::size_t residentCount;
+    std::size_t unusedCount;     // loaded but not referenced, can be evicted
+    std::size_t hits;            // requests served without loading anything
+    std::size_t misses;          // requests that loaded a file
+    std::size_t evictions;
+    sf::Time loadTime;           // total time spent in loading functions
+
+    float getHitRate() const
+    {
+        std::size_t requests = hits + misses;
+        return requests > 0 ? static_cast<float>(hits) / requests : 0.f;
+    }
+};
+
+/* The cache */
+template <typename Resource>
+class ResourceCache
+{
+    struct Entry;
+
+public:
+
+    /* The handle
+
+    Copying a handle adds a reference, destroying it removes one. Handles must
+    not outlive their cache.*/
+    class Handle
+    {
+    public:
+
+        Handle() :
+        m_entry(NULL)
+        {
+        }
+
+        Handle(const Handle& other) :
+        m_entry(other.m_entry)
+        {
+            if (m_entry)
+                m_entry->cache->acquire(*m_entry);
+        }
+
+        Handle& operator =(const Handle& other)
+        {
+            if (other.m_entry)
+                other.m_entry->cache->acquire(*other.m_entry);
+            if (m_entry)
+                m_entry->cache->release(*m_entry);
+
+            m_entry = other.m_entry;
+            return *this;
+        }
+
+        ~Handle()
+        {
+            if (m_entry)
+                m_entry->cache->release(*m_entry);
+        }
+
+        bool isValid() const
+        {
+            return m_entry != NULL;
+        }
+
+        const Resource& operator *() const
+        {
+            return m_entry->resource;
+        }
+
+        const Resource* operator ->() const
+        {
+            return &m_entry->resource;
+        }
+
+    private:
+
+        friend class ResourceCache;
+
+        explicit Handle(Entry& entry) :
+        m_entry(&entry)
+        {
+            m_entry->cache->acquire(*m_entry);
+        }
+
+        Entry* m_entry;
+    };
+
+    explicit ResourceCache(std::size_t budget) :
+    m_budget(budget)
+    {
+        m_stats.residentBytes = 0;
+        m_stats.residentCount = 0;
+        m_stats.unusedCount = 0;
+        m_stats.hits = 0;
+        m_stats.misses = 0;
+        m_stats.evictions = 0;
+    }
+
+    // return a handle to the resource loaded from path, loading it only if it
+    // is not in the cache yet; returns an invalid handle if loading fails
+    Handle get(const std::string& path)
+    {
+        typename EntryMap::iterator it = m_entries.find(path);
+        if (it != m_entries.end())
+        {
+            ++m_stats.hits;
+            return Handle(it->second);
+        }
+
+        ++m_stats.misses;
+
+        sf::Clock clock;
+        Entry& entry = m_entries[path];
+        entry.cache = this;
+        entry.references = 0;
+        entry.isUnused = false;
+        entry.bytes = 0;
+        bool loaded = ResourceTraits<Resource>::load(entry.resource, path, entry.bytes);
+        m_stats.loadTime += clock.getElapsedTime();
+
+        if (!loaded)
+        {
+            m_entries.erase(path);
+            return Handle();
+        }
+
+        entry.key = &m_entries.find(path)->first;
+        m_stats.residentBytes += entry.bytes;
+        ++m_stats.residentCount;
+
+        Handle handle(entry);
+
+        // the new resource may have pushed us over the budget
+        trim();
+
+        return handle;
+    }
+
+    // change the budget, evicting unused resources if needed
+    void setBudget(std::size_t budget)
+    {
+        m_budget = budget;
+        trim();
+    }
+
+    // evict all unused resources, for example when changing level
+    void purge()
+    {
+        std::size_t budget = m_budget;
+        m_budget = 0;
+        trim();
+        m_budget = budget;
+    }
+
+    const ResourceCacheStats& getStats() const
+    {
+        return m_stats;
+    }
+
+private:
+
+    // elements of unordered_map never move in memory, which is what makes it
+    // possible for handles and the LRU list to point to them
+    struct Entry
+    {
+        Resource resource;
+        ResourceCache* cache;
+        const std::string* key;
+        std::size_t bytes;
+        unsigned int references;
+        bool isUnused;
+        typename std::list<Entry*>::iterator unused; // valid if isUnused
+    };
+
+    typedef std::unordered_map<std::string, Entry> EntryMap;
+
+    void acquire(Entry& entry)
+    {
+        // a resource which is referenced again can't be evicted anymore
+        if (entry.references++ == 0 && entry.isUnused)
+        {
+            m_unused.erase(entry.unused);
+            entry.isUnused = false;
+            --m_stats.unusedCount;
+        }
+    }
+
+    void release(Entry& entry)
+    {
+        if (--entry.references > 0)
+            return;
+
+        // most recently used at the front, evicted from the back
+        m_unused.push_front(&entry);
+        entry.unused = m_unused.begin();
+        entry.isUnused = true;
+        ++m_stats.unusedCount;
+
+        trim();
+    }
+
+    // evict unused resources until we are under the budget
+    void trim()
+    {
+        while (m_stats.residentBytes > m_budget && !m_unused.empty())
+        {
+            Entry* entry = m_unused.back();
+            m_unused.pop_back();
+
+            m_stats.residentBytes -= entry->bytes;
+            --m_stats.residentCount;
+            --m_stats.unusedCount;
+            ++m_stats.evictions;
+
+            m_entries.erase(*entry->key);
+        }
+    }
+
+    EntryMap m_entries;
+    std::list<Entry*> m_unused;
+    std::size_t m_budget;
+    ResourceCacheStats m_stats;
+};
+
+//Note that the budget is only applied to unused resources: resources which are
+//still referenced are never evicted, even if they alone take more memory than
+//the budget. The budget is therefore the amount of memory that you accept to
+//waste for resources that may be used again later.
+
+//The paths are used as is, so "./tree.png" and "tree.png" are two different
+//entries. Normalize your paths (or use your own IDs) before asking the cache.
+
+/* With a cache, the function of the white square problem now works: the sprite
+is returned along with the handle that keeps its texture alive. */
+typedef ResourceCache<sf::Texture> TextureCache;
+
+struct TexturedSprite
+{
+    TextureCache::Handle texture;
+    sf::Sprite sprite;
+};
+
+TexturedSprite loadSprite(TextureCache& cache, const std::string& filename)
+{
+    TexturedSprite result;
+    result.texture = cache.get(filename);
+    if (result.texture.isValid())
+        result.sprite.setTexture(*result.texture);
+
+    return result;
+} // no error: the cache keeps the texture alive
+
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Resource cache");
+
+    // keep at most 64 MB of textures which are not used anymore
+    TextureCache textures(64 * 1024 * 1024);
+
+    // the same file, requested twice: it is loaded only once
+    TexturedSprite tree1 = loadSprite(textures, "tree.png");
+    TexturedSprite tree2 = loadSprite(textures, "tree.png");
+    tree2.sprite.setPosition(200, 0);
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        window.clear();
+        window.draw(tree1.sprite);
+        window.draw(tree2.sprite);
+        window.display();
+    }
+
+    const ResourceCacheStats& stats = textures.getStats();
+    std::cout << "resident: " << stats.residentBytes / 1024 << " KB in "
+              << stats.residentCount << " textures" << std::endl;
+    std::cout << "hit rate: " << stats.getHitRate() * 100 << "%" << std::endl;
+    std::cout << "load time: " << stats.loadTime.asMilliseconds() << " ms" << std::endl;
+
+    return 0;
+}
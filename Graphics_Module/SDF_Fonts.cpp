@@ -0,0 +1,582 @@
+/* One glyph atlas for all sizes: signed distance field fonts
+
+compile with:  g++ -c SDF_Fonts.cpp -I/usr/include/freetype2
+and then link to get the executable with:
+
+    g++ SDF_Fonts.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system -lfreetype
+*/
+
+/* Introduction
+
+sf::Font rasterizes glyphs for each character size separately, and each
+character size has its own texture. A game that uses 8 sizes keeps 8 glyph
+textures in memory, and switches textures every time consecutive texts have
+different sizes. Worse, a text that is scaled (or seen through a zoomed view)
+is just a stretched bitmap: blurry when it's enlarged, aliased when it's
+reduced.
+
+A signed distance field (SDF) stores something else in the texture: for each
+pixel, not whether it's inside the glyph, but how far it is from the glyph's
+edge -- positive inside, negative outside. When such a texture is drawn
+enlarged, the GPU interpolates between distances, which gives a smooth,
+accurate edge; a fragment shader then turns the distance into coverage with a
+threshold at 0 ("on the edge"). So the glyphs are generated once, at a single
+reference size (48 pixels here), and the same atlas draws sharp text from 8 to
+several hundreds of pixels.
+
+sf::Font doesn't give access to the outlines of the glyphs, so we use FreeType
+directly, which is what SFML uses internally, and is installed with it.*/
+
+#include <SFML/Graphics.hpp>
+#include <ft2build.h>
+#include FT_FREETYPE_H
+#include FT_OUTLINE_H
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+/* Computing the distance field
+
+FreeType describes the outline of a glyph as closed contours made of lines and
+Bezier curves. We flatten the curves into short lines, then, for each pixel of
+the glyph's cell:
+
+- the distance is the distance to the closest line
+- the sign comes from the winding number of the contours around the pixel
+  (TrueType and OpenType fonts use the non-zero rule, so the direction of the
+  contours doesn't matter)
+
+Distances beyond "spread" pixels are clamped, and the cell has a margin of
+"spread" pixels around the glyph, so that the distance can fade out entirely.
+The distance is stored in the alpha channel: 128 on the edge, 255 at spread
+pixels inside, 0 at spread pixels outside.*/
+namespace
+{
+    struct Segment
+    {
+        sf::Vector2f a;
+        sf::Vector2f b;
+    };
+
+    // receives the outline from FT_Outline_Decompose, and flattens it
+    struct Flattener
+    {
+        std::vector<Segment> segments;
+        sf::Vector2f current;
+
+        static sf::Vector2f toPixels(const FT_Vector* point)
+        {
+            return sf::Vector2f(point->x / 64.f, point->y / 64.f);
+        }
+
+        void lineTo(sf::Vector2f point)
+        {
+            Segment segment = {current, point};
+            if (point != current)
+                segments.push_back(segment);
+            current = point;
+        }
+
+        static int moveTo(const FT_Vector* to, void* user)
+        {
+            static_cast<Flattener*>(user)->current = toPixels(to);
+            return 0;
+        }
+
+        static int lineTo(const FT_Vector* to, void* user)
+        {
+            static_cast<Flattener*>(user)->lineTo(toPixels(to));
+            return 0;
+        }
+
+        // 8 lines per curve are enough at the sizes the atlas uses
+        static int conicTo(const FT_Vector* control, const FT_Vector* to, void* user)
+        {
+            Flattener& self = *static_cast<Flattener*>(user);
+            sf::Vector2f p0 = self.current, p1 = toPixels(control), p2 = toPixels(to);
+            for (int i = 1; i <= 8; ++i)
+            {
+                float t = i / 8.f, u = 1 - t;
+                self.lineTo(p0 * (u * u) + p1 * (2 * u * t) + p2 * (t * t));
+            }
+            return 0;
+        }
+
+        static int cubicTo(const FT_Vector* control1, const FT_Vector* control2, const FT_Vector* to, void* user)
+        {
+            Flattener& self = *static_cast<Flattener*>(user);
+            sf::Vector2f p0 = self.current, p1 = toPixels(control1), p2 = toPixels(control2), p3 = toPixels(to);
+            for (int i = 1; i <= 8; ++i)
+            {
+                float t = i / 8.f, u = 1 - t;
+                self.lineTo(p0 * (u * u * u) + p1 * (3 * u * u * t) + p2 * (3 * u * t * t) + p3 * (t * t * t));
+            }
+            return 0;
+        }
+    };
+
+    float distanceToSegment(sf::Vector2f point, const Segment& segment)
+    {
+        sf::Vector2f ab = segment.b - segment.a;
+        sf::Vector2f ap = point - segment.a;
+        float t = (ap.x * ab.x + ap.y * ab.y) / (ab.x * ab.x + ab.y * ab.y);
+        t = std::max(0.f, std::min(1.f, t));
+
+        sf::Vector2f closest = ap - ab * t;
+        return std::sqrt(closest.x * closest.x + closest.y * closest.y);
+    }
+
+    // +1 if the segment crosses the horizontal line on the right of the point
+    // upwards, -1 downwards, 0 if it doesn't
+    int winding(sf::Vector2f point, const Segment& segment)
+    {
+        const sf::Vector2f& a = segment.a;
+        const sf::Vector2f& b = segment.b;
+        float side = (b.x - a.x) * (point.y - a.y) - (point.x - a.x) * (b.y - a.y);
+
+        if (a.y <= point.y && b.y > point.y && side > 0)
+            return 1;
+        if (b.y <= point.y && a.y > point.y && side < 0)
+            return -1;
+        return 0;
+    }
+}
+
+/* The SDF font
+
+The metrics are stored for a character size of 1 (in "ems"): to draw at a
+given character size, they are simply multiplied by it. The kerning pairs are
+the unhinted ones, since hinting only makes sense for a particular size.
+
+The atlas is filled with the same shelf packing as the glyph atlas of the
+prewarming tutorial, and with a smooth texture: interpolation between
+distances is what makes the edges sharp.*/
+class SdfFont
+{
+public:
+
+    struct Glyph
+    {
+        float advance;
+        sf::FloatRect bounds;   // the whole cell, margin included
+        sf::IntRect textureRect;
+    };
+
+    SdfFont() :
+    m_lineSpacing(1.f)
+    {
+    }
+
+    // generate the atlas for the given characters; emSize is the reference
+    // character size, spread the range of the distances, in pixels at the
+    // reference size
+    bool loadFromFile(const std::string& filename, const sf::String& characters,
+                      unsigned int emSize = 48, unsigned int spread = 6)
+    {
+        FT_Library library;
+        if (FT_Init_FreeType(&library) != 0)
+            return false;
+
+        FT_Face face;
+        if (FT_New_Face(library, filename.c_str(), 0, &face) != 0 || !FT_IS_SCALABLE(face))
+        {
+            FT_Done_FreeType(library);
+            return false;
+        }
+
+        FT_Set_Pixel_Sizes(face, 0, emSize);
+        float em = static_cast<float>(emSize);
+        m_lineSpacing = static_cast<float>(face->height) / face->units_per_EM;
+
+        std::vector<Cell> cells;
+        m_glyphs.clear();
+        m_kerning.clear();
+
+        for (std::size_t i = 0; i < characters.getSize(); ++i)
+        {
+            sf::Uint32 codePoint = characters[i];
+            if (FT_Load_Char(face, codePoint, FT_LOAD_NO_HINTING | FT_LOAD_NO_BITMAP) != 0 ||
+                face->glyph->format != FT_GLYPH_FORMAT_OUTLINE)
+                continue;
+
+            Cell cell;
+            cell.codePoint = codePoint;
+            cell.glyph.advance = face->glyph->advance.x / 64.f / em;
+            generateDistanceField(face->glyph->outline, static_cast<float>(spread), cell);
+
+            // from pixels at the reference size, to ems, with y pointing down
+            cell.glyph.bounds = sf::FloatRect(cell.origin.x / em, -cell.origin.y / em,
+                                              cell.width / em, cell.height / em);
+            cells.push_back(cell);
+
+            // kerning pairs that start with this character
+            if (FT_HAS_KERNING(face))
+            {
+                FT_UInt left = FT_Get_Char_Index(face, codePoint);
+                for (std::size_t j = 0; j < characters.getSize(); ++j)
+                {
+                    FT_Vector kerning;
+                    FT_UInt right = FT_Get_Char_Index(face, characters[j]);
+                    if (FT_Get_Kerning(face, left, right, FT_KERNING_UNFITTED, &kerning) == 0 && kerning.x != 0)
+                        m_kerning[pairKey(codePoint, characters[j])] = kerning.x / 64.f / em;
+                }
+            }
+        }
+
+        FT_Done_Face(face);
+        FT_Done_FreeType(library);
+
+        return pack(cells);
+    }
+
+    // NULL if the character is not in the atlas
+    const Glyph* getGlyph(sf::Uint32 codePoint) const
+    {
+        std::unordered_map<sf::Uint32, Glyph>::const_iterator it = m_glyphs.find(codePoint);
+        return it != m_glyphs.end() ? &it->second : NULL;
+    }
+
+    // in ems: multiply by the character size
+    float getKerning(sf::Uint32 first, sf::Uint32 second) const
+    {
+        std::unordered_map<sf::Uint64, float>::const_iterator it = m_kerning.find(pairKey(first, second));
+        return it != m_kerning.end() ? it->second : 0.f;
+    }
+
+    // in ems: multiply by the character size
+    float getLineSpacing() const
+    {
+        return m_lineSpacing;
+    }
+
+    const sf::Texture& getTexture() const
+    {
+        return m_texture;
+    }
+
+private:
+
+    struct Cell
+    {
+        sf::Uint32 codePoint;
+        Glyph glyph;
+        sf::Vector2f origin; // top-left corner of the cell, in outline coordinates
+        int width;
+        int height;
+        std::vector<sf::Uint8> distances;
+    };
+
+    static sf::Uint64 pairKey(sf::Uint32 first, sf::Uint32 second)
+    {
+        return (static_cast<sf::Uint64>(first) << 32) | second;
+    }
+
+    static void generateDistanceField(FT_Outline& outline, float spread, Cell& cell)
+    {
+        Flattener flattener;
+        FT_Outline_Funcs functions;
+        functions.move_to = &Flattener::moveTo;
+        functions.line_to = &Flattener::lineTo;
+        functions.conic_to = &Flattener::conicTo;
+        functions.cubic_to = &Flattener::cubicTo;
+        functions.shift = 0;
+        functions.delta = 0;
+
+        // FT_Outline_Decompose closes each contour with a line to its first
+        // point, so we get closed polygons
+        FT_Outline_Decompose(&outline, &functions, &flattener);
+
+        // the cell: the bounding box of the outline, in whole pixels, plus
+        // the margin
+        FT_BBox box;
+        FT_Outline_Get_CBox(&outline, &box);
+        float left   = std::floor(box.xMin / 64.f) - spread;
+        float bottom = std::floor(box.yMin / 64.f) - spread;
+        float right  = std::ceil(box.xMax / 64.f) + spread;
+        float top    = std::ceil(box.yMax / 64.f) + spread;
+
+        cell.origin = sf::Vector2f(left, top);
+        cell.width = static_cast<int>(right - left);
+        cell.height = static_cast<int>(top - bottom);
+        cell.distances.resize(static_cast<std::size_t>(cell.width) * cell.height);
+
+        const std::vector<Segment>& segments = flattener.segments;
+        for (int y = 0; y < cell.height; ++y)
+            for (int x = 0; x < cell.width; ++x)
+            {
+                // the center of the pixel; rows go down, the outline goes up
+                sf::Vector2f point(left + x + 0.5f, top - y - 0.5f);
+
+                float distance = spread;
+                int windingNumber = 0;
+                for (std::size_t i = 0; i < segments.size(); ++i)
+                {
+                    distance = std::min(distance, distanceToSegment(point, segments[i]));
+                    windingNumber += winding(point, segments[i]);
+                }
+
+                if (windingNumber == 0)
+                    distance = -distance;
+
+                float value = 128.f + distance / spread * 127.f;
+                cell.distances[x + y * cell.width] = static_cast<sf::Uint8>(std::max(0.f, std::min(255.f, value)));
+            }
+    }
+
+    static bool higher(const Cell& left, const Cell& right)
+    {
+        if (left.height != right.height)
+            return left.height > right.height;
+        return left.codePoint < right.codePoint;
+    }
+
+    bool pack(std::vector<Cell>& cells)
+    {
+        if (cells.empty())
+            return false;
+
+        // the cells already have a transparent margin, but smoothing still
+        // needs one pixel between them
+        std::sort(cells.begin(), cells.end(), &SdfFont::higher);
+
+        int width = 1024;
+        int x = 0;
+        int y = 0;
+        int rowHeight = 0;
+
+        for (std::size_t i = 0; i < cells.size(); ++i)
+        {
+            sf::IntRect& rect = cells[i].glyph.textureRect;
+            if (x + cells[i].width + 1 > width)
+            {
+                x = 0;
+                y += rowHeight;
+                rowHeight = 0;
+            }
+
+            rect = sf::IntRect(x, y, cells[i].width, cells[i].height);
+            x += cells[i].width + 1;
+            rowHeight = std::max(rowHeight, cells[i].height + 1);
+        }
+
+        // white pixels, with the distance as alpha; the empty space is "far
+        // outside"
+        int height = y + rowHeight;
+        std::vector<sf::Uint8> pixels(static_cast<std::size_t>(width) * height * 4, 255);
+        for (std::size_t i = 3; i < pixels.size(); i += 4)
+            pixels[i] = 0;
+
+        for (std::size_t i = 0; i < cells.size(); ++i)
+        {
+            const sf::IntRect& rect = cells[i].glyph.textureRect;
+            for (int row = 0; row < rect.height; ++row)
+                for (int column = 0; column < rect.width; ++column)
+                    pixels[((rect.left + column) + (rect.top + row) * width) * 4 + 3] = cells[i].distances[column + row * rect.width];
+
+            m_glyphs[cells[i].codePoint] = cells[i].glyph;
+        }
+
+        sf::Image image;
+        image.create(width, height, &pixels[0]);
+        if (!m_texture.loadFromImage(image))
+            return false;
+
+        m_texture.setSmooth(true);
+        return true;
+    }
+
+    float m_lineSpacing;
+    sf::Texture m_texture;
+    std::unordered_map<sf::Uint32, Glyph> m_glyphs;
+    std::unordered_map<sf::Uint64, float> m_kerning;
+};
+
+/* The text renderer
+
+Since all the sizes use the same texture, a single renderer can hold texts of
+any size (like the text batch of the text batching tutorial, but without the
+"one character size per batch" limit), and draw them at once, through the SDF
+shader.
+
+The shader reads the distance, and turns it into coverage around the edge
+(0.5, i.e. 128). fwidth gives how much the distance changes from one pixel on
+screen to the next, so the transition is always about one pixel wide: sharp
+and antialiased at any size and any scale.*/
+class SdfTextRenderer : public sf::Drawable, public sf::Transformable
+{
+public:
+
+    explicit SdfTextRenderer(const SdfFont& font) :
+    m_font(&font)
+    {
+    }
+
+    bool loadShader()
+    {
+        static const std::string fragmentShader =
+            "uniform sampler2D texture;"
+            "void main()"
+            "{"
+            "    float distance = texture2D(texture, gl_TexCoord[0].xy).a;"
+            "    float width = fwidth(distance);"
+            "    float alpha = smoothstep(0.5 - width, 0.5 + width, distance);"
+            "    gl_FragColor = vec4(gl_Color.rgb, gl_Color.a * alpha);"
+            "}";
+
+        if (!sf::Shader::isAvailable() || !m_shader.loadFromMemory(fragmentShader, sf::Shader::Fragment))
+            return false;
+
+        m_shader.setUniform("texture", sf::Shader::CurrentTexture);
+        return true;
+    }
+
+    void clear()
+    {
+        m_vertices.clear();
+    }
+
+    // the character size can be any value, including fractional ones
+    void add(const sf::String& string, sf::Vector2f position, float characterSize,
+             const sf::Color& color = sf::Color::White)
+    {
+        const SdfFont::Glyph* space = m_font->getGlyph(L' ');
+        float whitespaceWidth = (space ? space->advance : 0.3f) * characterSize;
+        float lineSpacing = m_font->getLineSpacing() * characterSize;
+
+        float x = 0.f;
+        float y = characterSize;
+        sf::Uint32 previous = 0;
+
+        for (std::size_t i = 0; i < string.getSize(); ++i)
+        {
+            sf::Uint32 current = string[i];
+
+            x += m_font->getKerning(previous, current) * characterSize;
+            previous = current;
+
+            if (current == L' ' || current == L'\t')
+            {
+                x += whitespaceWidth * (current == L'\t' ? 4 : 1);
+                continue;
+            }
+            if (current == L'\n')
+            {
+                y += lineSpacing;
+                x = 0;
+                continue;
+            }
+
+            const SdfFont::Glyph* glyph = m_font->getGlyph(current);
+            if (!glyph)
+                continue;
+
+            float left   = position.x + x + glyph->bounds.left * characterSize;
+            float top    = position.y + y + glyph->bounds.top * characterSize;
+            float right  = left + glyph->bounds.width * characterSize;
+            float bottom = top + glyph->bounds.height * characterSize;
+
+            float u1 = static_cast<float>(glyph->textureRect.left);
+            float v1 = static_cast<float>(glyph->textureRect.top);
+            float u2 = static_cast<float>(glyph->textureRect.left + glyph->textureRect.width);
+            float v2 = static_cast<float>(glyph->textureRect.top + glyph->textureRect.height);
+
+            m_vertices.push_back(sf::Vertex(sf::Vector2f(left, top), color, sf::Vector2f(u1, v1)));
+            m_vertices.push_back(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1)));
+            m_vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2)));
+            m_vertices.push_back(sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2)));
+            m_vertices.push_back(sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1)));
+            m_vertices.push_back(sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(u2, v2)));
+
+            x += glyph->advance * characterSize;
+        }
+    }
+
+    std::size_t getVertexCount() const
+    {
+        return m_vertices.size();
+    }
+
+private:
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
+    {
+        if (m_vertices.empty())
+            return;
+
+        states.transform *= getTransform();
+        states.texture = &m_font->getTexture();
+        states.shader = &m_shader;
+        target.draw(&m_vertices[0], m_vertices.size(), sf::Triangles, states);
+    }
+
+    const SdfFont* m_font;
+    sf::Shader m_shader;
+    std::vector<sf::Vertex> m_vertices;
+};
+
+//The distance field also makes a few effects cheap: moving the threshold below
+//0.5 makes the text bolder, and drawing the same text first with a lower
+//threshold and a dark color gives an outline, all from the same atlas.
+
+//Very small texts (below about 10 pixels) look a little softer than with
+//sf::Text, which uses hinting to align the glyphs on the pixel grid. For body
+//text at a fixed small size, sf::Font is still the better choice.
+
+//Generating the atlas takes some time, since every pixel is compared with every
+//line of the outline. Like in the prewarming tutorial, it can be done once and
+//saved to a file.
+
+/* A demo: texts from 10 to 200 pixels, all from one 48-pixel atlas, drawn with
+one draw call. Zoom with the mouse wheel: the edges stay sharp. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "SDF fonts");
+
+    sf::String characters;
+    for (sf::Uint32 c = 0x20; c < 0x7F; ++c)
+        characters += c;
+
+    SdfFont font;
+    sf::Clock clock;
+    if (!font.loadFromFile("arial.ttf", characters))
+        return -1;
+
+    std::cout << "atlas generated in " << clock.getElapsedTime().asMilliseconds() << " ms, "
+              << font.getTexture().getSize().x << "x" << font.getTexture().getSize().y << " pixels" << std::endl;
+
+    SdfTextRenderer text(font);
+    if (!text.loadShader())
+        return -1;
+
+    float y = 10;
+    for (float size = 10; size <= 200; size *= 1.6f)
+    {
+        text.add("Sharp at any size", sf::Vector2f(10, y), size, sf::Color::White);
+        y += size * font.getLineSpacing();
+    }
+
+    sf::View view = window.getDefaultView();
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+
+            if (event.type == sf::Event::MouseWheelScrolled)
+                view.zoom(event.mouseWheelScroll.delta > 0 ? 0.8f : 1.25f);
+        }
+
+        window.setView(view);
+        window.clear();
+        window.draw(text);
+        window.display();
+    }
+
+    return 0;
+}
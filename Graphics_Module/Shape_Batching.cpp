@@ -0,0 +1,335 @@
+/* Drawing many shapes with a shape batch
+
+compile with:  g++ -c Shape_Batching.cpp
+and then link to get the executable with:
+
+    g++ Shape_Batching.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+Shapes are the easiest way to draw debug overlays, charts or simple UIs. But
+every sf::CircleShape, sf::RectangleShape or sf::ConvexShape draws itself with
+its own draw calls: one for its fill, and one more for its outline. With a few
+thousand shapes per frame, the draw calls cost far more than the triangles
+themselves.
+
+A shape batch keeps the shape classes as they are -- you still create and
+configure shapes with their usual functions -- but instead of drawing them one
+by one, you add them to the batch. The batch computes their triangles exactly
+like sf::Shape does, applies their transform, and appends everything to a
+single sf::Triangles vertex array. 20000 shapes, with or without outline, are
+then drawn with a single draw call.
+
+The batch is for untextured shapes (which is what overlays and charts are made
+of). For textured rectangles, see the sprite batching tutorial.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+// the points of the unit circle, computed once per point count (see the custom
+// shapes section of the shapes tutorial)
+const std::vector<sf::Vector2f>& getUnitCircle(std::size_t pointCount)
+{
+    static std::map<std::size_t, std::vector<sf::Vector2f> > tables;
+
+    std::vector<sf::Vector2f>& table = tables[pointCount];
+    if (table.empty())
+    {
+        static const float pi = 3.141592654f;
+
+        table.resize(pointCount);
+        for (std::size_t i = 0; i < pointCount; ++i)
+        {
+            float angle = i * 2 * pi / pointCount - pi / 2;
+            table[i] = sf::Vector2f(std::cos(angle), std::sin(angle));
+        }
+    }
+
+    return table;
+}
+
+/* The shape batch
+
+Like sf::Shape, the fill is a fan of triangles around the center of the shape's
+bounding box (so stars work too), and the outline is a band around the points,
+extruded along the average normal of the two edges that meet at each point.
+Since everything goes into the same array of independent triangles, each fan
+and each band is converted to a list of triangles.
+
+sf::CircleShape and sf::RectangleShape are recognized and handled without
+calling their virtual getPoint function: the points of a circle come from the
+unit circle table, which avoids a cosine and a sine per point. Any other shape
+class (including your own) goes through getPointCount and getPoint.*/
+class ShapeBatch : public sf::Drawable
+{
+public:
+
+    ShapeBatch() :
+    m_vertexCount(0)
+    {
+    }
+
+    // forget the shapes of the previous frame, but keep the allocated memory
+    void clear()
+    {
+        m_vertexCount = 0;
+    }
+
+    void add(const sf::Shape& shape)
+    {
+        getPoints(shape);
+
+        std::size_t count = m_points.size();
+        if (count < 3)
+            return;
+
+        // center of the bounding box, in local coordinates
+        sf::Vector2f min = m_points[0];
+        sf::Vector2f max = m_points[0];
+        for (std::size_t i = 1; i < count; ++i)
+        {
+            min.x = std::min(min.x, m_points[i].x);
+            min.y = std::min(min.y, m_points[i].y);
+            max.x = std::max(max.x, m_points[i].x);
+            max.y = std::max(max.y, m_points[i].y);
+        }
+        sf::Vector2f center = (min + max) / 2.f;
+
+        float thickness = shape.getOutlineThickness();
+        bool hasOutline = thickness != 0 && shape.getOutlineColor().a > 0;
+        bool hasFill = shape.getFillColor().a > 0;
+
+        // the outline is extruded in local coordinates, before transforming
+        if (hasOutline)
+            computeOutline(center, thickness);
+
+        // transform everything to world coordinates, once per point
+        const sf::Transform& transform = shape.getTransform();
+        sf::Vector2f worldCenter = transform.transformPoint(center);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            m_points[i] = transform.transformPoint(m_points[i]);
+            if (hasOutline)
+                m_outline[i] = transform.transformPoint(m_outline[i]);
+        }
+
+        std::size_t needed = (hasFill ? count * 3 : 0) + (hasOutline ? count * 6 : 0);
+        if (m_vertexCount + needed > m_vertices.size())
+            m_vertices.resize(std::max(m_vertices.size() * 2, m_vertexCount + needed));
+
+        sf::Vertex* vertex = &m_vertices[m_vertexCount];
+        m_vertexCount += needed;
+
+        if (hasFill)
+        {
+            sf::Color color = shape.getFillColor();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::size_t next = (i + 1 < count) ? i + 1 : 0;
+                *vertex++ = sf::Vertex(worldCenter, color);
+                *vertex++ = sf::Vertex(m_points[i], color);
+                *vertex++ = sf::Vertex(m_points[next], color);
+            }
+        }
+
+        if (hasOutline)
+        {
+            sf::Color color = shape.getOutlineColor();
+            for (std::size_t i = 0; i < count; ++i)
+            {
+                std::size_t next = (i + 1 < count) ? i + 1 : 0;
+                *vertex++ = sf::Vertex(m_points[i], color);
+                *vertex++ = sf::Vertex(m_outline[i], color);
+                *vertex++ = sf::Vertex(m_points[next], color);
+                *vertex++ = sf::Vertex(m_points[next], color);
+                *vertex++ = sf::Vertex(m_outline[i], color);
+                *vertex++ = sf::Vertex(m_outline[next], color);
+            }
+        }
+    }
+
+    std::size_t getVertexCount() const
+    {
+        return m_vertexCount;
+    }
+
+private:
+
+    // fill m_points with the local points of the shape
+    void getPoints(const sf::Shape& shape)
+    {
+        if (const sf::CircleShape* circle = dynamic_cast<const sf::CircleShape*>(&shape))
+        {
+            const std::vector<sf::Vector2f>& unit = getUnitCircle(circle->getPointCount());
+            float radius = circle->getRadius();
+
+            m_points.resize(unit.size());
+            for (std::size_t i = 0; i < unit.size(); ++i)
+                m_points[i] = sf::Vector2f(radius + unit[i].x * radius, radius + unit[i].y * radius);
+        }
+        else if (const sf::RectangleShape* rectangle = dynamic_cast<const sf::RectangleShape*>(&shape))
+        {
+            sf::Vector2f size = rectangle->getSize();
+
+            m_points.resize(4);
+            m_points[0] = sf::Vector2f(0, 0);
+            m_points[1] = sf::Vector2f(size.x, 0);
+            m_points[2] = sf::Vector2f(size.x, size.y);
+            m_points[3] = sf::Vector2f(0, size.y);
+        }
+        else
+        {
+            m_points.resize(shape.getPointCount());
+            for (std::size_t i = 0; i < m_points.size(); ++i)
+                m_points[i] = shape.getPoint(i);
+        }
+    }
+
+    // fill m_outline with the extruded points, the same way sf::Shape does
+    void computeOutline(sf::Vector2f center, float thickness)
+    {
+        std::size_t count = m_points.size();
+        m_outline.resize(count);
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            sf::Vector2f p0 = m_points[i > 0 ? i - 1 : count - 1];
+            sf::Vector2f p1 = m_points[i];
+            sf::Vector2f p2 = m_points[i + 1 < count ? i + 1 : 0];
+
+            sf::Vector2f n1 = computeNormal(p0, p1);
+            sf::Vector2f n2 = computeNormal(p1, p2);
+
+            // make sure that the normals point towards the outside of the shape
+            if (dot(n1, center - p1) > 0)
+                n1 = -n1;
+            if (dot(n2, center - p1) > 0)
+                n2 = -n2;
+
+            // combine them to get the extrusion direction
+            float factor = 1.f + (n1.x * n2.x + n1.y * n2.y);
+            sf::Vector2f normal = (n1 + n2) / factor;
+
+            m_outline[i] = p1 + normal * thickness;
+        }
+    }
+
+    static sf::Vector2f computeNormal(sf::Vector2f p1, sf::Vector2f p2)
+    {
+        sf::Vector2f normal(p1.y - p2.y, p2.x - p1.x);
+        float length = std::sqrt(normal.x * normal.x + normal.y * normal.y);
+        if (length != 0.f)
+            normal /= length;
+        return normal;
+    }
+
+    static float dot(sf::Vector2f a, sf::Vector2f b)
+    {
+        return a.x * b.x + a.y * b.y;
+    }
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
+    {
+        if (m_vertexCount == 0)
+            return;
+
+        // the vertices are already transformed, only apply the caller's
+        // transform; one draw call for everything
+        states.texture = NULL;
+        target.draw(&m_vertices[0], m_vertexCount, sf::Triangles, states);
+    }
+
+    std::vector<sf::Vertex> m_vertices;
+    std::size_t m_vertexCount;
+
+    // scratch buffers, kept to avoid allocations
+    std::vector<sf::Vector2f> m_points;
+    std::vector<sf::Vector2f> m_outline;
+};
+
+//Shapes are drawn in the order in which they are added, and the outline of a
+//shape is drawn after its fill, exactly as if you had drawn the shapes one by
+//one.
+
+//Since each shape is tessellated again when it is added, the batch doesn't
+//care whether shapes change between frames. If most of your shapes are static,
+//fill the batch once and only draw it every frame.
+
+/* A demo with 20000 shapes */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Shape batch");
+
+    // a mix of circles, rectangles and triangles
+    std::vector<sf::CircleShape> circles(10000);
+    std::vector<sf::RectangleShape> rectangles(8000);
+    std::vector<sf::ConvexShape> triangles(2000);
+
+    for (std::size_t i = 0; i < circles.size(); ++i)
+    {
+        circles[i].setRadius(static_cast<float>(2 + std::rand() % 6));
+        circles[i].setPointCount(12);
+        circles[i].setPosition(static_cast<float>(std::rand() % 800),
+                               static_cast<float>(std::rand() % 600));
+        circles[i].setFillColor(sf::Color(std::rand() % 256, std::rand() % 256, 255, 160));
+    }
+
+    for (std::size_t i = 0; i < rectangles.size(); ++i)
+    {
+        rectangles[i].setSize(sf::Vector2f(8, static_cast<float>(4 + std::rand() % 20)));
+        rectangles[i].setPosition(static_cast<float>(std::rand() % 800),
+                                  static_cast<float>(std::rand() % 600));
+        rectangles[i].setFillColor(sf::Color::Transparent);
+        rectangles[i].setOutlineColor(sf::Color::Green);
+        rectangles[i].setOutlineThickness(1);
+    }
+
+    for (std::size_t i = 0; i < triangles.size(); ++i)
+    {
+        triangles[i].setPointCount(3);
+        triangles[i].setPoint(0, sf::Vector2f(0, 0));
+        triangles[i].setPoint(1, sf::Vector2f(10, 5));
+        triangles[i].setPoint(2, sf::Vector2f(0, 10));
+        triangles[i].setPosition(static_cast<float>(std::rand() % 800),
+                                 static_cast<float>(std::rand() % 600));
+        triangles[i].setFillColor(sf::Color::Red);
+    }
+
+    ShapeBatch batch;
+    sf::Clock clock;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        // the shapes are modified as usual...
+        float angle = clock.getElapsedTime().asSeconds() * 90.f;
+        for (std::size_t i = 0; i < triangles.size(); ++i)
+            triangles[i].setRotation(angle);
+
+        // ...but added to the batch instead of being drawn
+        batch.clear();
+        for (std::size_t i = 0; i < circles.size(); ++i)
+            batch.add(circles[i]);
+        for (std::size_t i = 0; i < rectangles.size(); ++i)
+            batch.add(rectangles[i]);
+        for (std::size_t i = 0; i < triangles.size(); ++i)
+            batch.add(triangles[i]);
+
+        window.clear();
+        window.draw(batch);
+        window.display();
+    }
+
+    return 0;
+}
@@ -175,13 +175,46 @@ You must also call the update() protected function whenever any point in your
 shape changes, so that the base class is informed and can update its internal
 geometry.
 
-Here is a complete example of a custom shape class: EllipseShape.*/
+Here is a complete example of a custom shape class: EllipseShape.
+
+Since getPoint is called for every point each time update() is called, it has
+to be cheap. Computing the points of an ellipse requires a cosine and a sine
+per point, but they only depend on the number of points: they are the points
+of the unit circle, which we compute once per point count and share between all
+the ellipses. Resizing an ellipse then only costs two multiplications per
+point.*/
+
+// the points of the unit circle, computed once per point count and shared by
+// all the shapes; std::map never moves its elements, so the returned
+// reference stays valid (but this function is not thread-safe)
+const std::vector<sf::Vector2f>& getUnitCircle(unsigned int pointCount)
+{
+    static std::map<unsigned int, std::vector<sf::Vector2f> > tables;
+
+    std::vector<sf::Vector2f>& table = tables[pointCount];
+    if (table.empty())
+    {
+        static const float pi = 3.141592654f;
+
+        table.resize(pointCount);
+        for (unsigned int i = 0; i < pointCount; ++i)
+        {
+            float angle = i * 2 * pi / pointCount - pi / 2;
+            table[i] = sf::Vector2f(std::cos(angle), std::sin(angle));
+        }
+    }
+
+    return table;
+}
+
 class EllipseShape : public sf::Shape
 {
 public :
 
-    explicit EllipseShape(const sf::Vector2f& radius = sf::Vector2f(0, 0)) :
-    m_radius(radius)
+    explicit EllipseShape(const sf::Vector2f& radius = sf::Vector2f(0, 0),
+                          unsigned int pointCount = 30) :
+    m_radius(radius),
+    m_unitCircle(&getUnitCircle(pointCount))
     {
         update();
     }
@@ -197,27 +230,35 @@ public :
         return m_radius;
     }
 
+    void setPointCount(unsigned int count)
+    {
+        m_unitCircle = &getUnitCircle(count);
+        update();
+    }
+
     virtual unsigned int getPointCount() const
     {
-        return 30; // fixed, but could be an attribute of the class if needed
+        return static_cast<unsigned int>(m_unitCircle->size());
     }
 
     virtual sf::Vector2f getPoint(unsigned int index) const
     {
-        static const float pi = 3.141592654f;
-
-        float angle = index * 2 * pi / getPointCount() - pi / 2;
-        float x = std::cos(angle) * m_radius.x;
-        float y = std::sin(angle) * m_radius.y;
+        const sf::Vector2f& point = (*m_unitCircle)[index];
 
-        return sf::Vector2f(m_radius.x + x, m_radius.y + y);
+        return sf::Vector2f(m_radius.x + point.x * m_radius.x,
+                            m_radius.y + point.y * m_radius.y);
     }
 
 private :
 
     sf::Vector2f m_radius;
+    const std::vector<sf::Vector2f>* m_unitCircle;
 };
 
+//The same trick works for any shape whose points are a fixed pattern scaled by
+//a few parameters (rounded rectangles, stars, ...): precompute the pattern,
+//and only apply the parameters in getPoint.
+
 /* Antialiased shapes
 
 There's no option to anti-alias a single shape. To get anti-aliased
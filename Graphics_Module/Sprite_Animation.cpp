@@ -0,0 +1,302 @@
+/* Animating thousands of sprites
+
+compile with:  g++ -c Sprite_Animation.cpp
+and then link to get the executable with:
+
+    g++ Sprite_Animation.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+The usual way to animate a sprite is to give it a new texture rect at every
+frame:
+
+    sprite.setTextureRect(sf::IntRect(frame * 32, row * 32, 32, 32));
+
+It works, but it does the same work again and again: the rect of a frame is
+computed at each update, then the sprite converts it back to texture
+coordinates, and every animated sprite is updated on its own, in its own
+object, somewhere in memory.
+
+With thousands of animated sprites, it's much more efficient to turn this
+around:
+
+1. the frames of a sprite sheet never change, so their texture coordinates are
+   computed once, when the sheet is created, and stored in a table
+2. an animation (a clip) is just a range of frames in this table and a duration
+   per frame, expressed with sf::Time
+3. the state of all the animated sprites (which clip, since when) is stored in
+   a few contiguous arrays, and updated by a single loop that writes texture
+   coordinates straight into a vertex array
+
+The loop reads and writes memory sequentially, which is what CPU caches are
+best at.*/
+
+#include <SFML/Graphics.hpp>
+#include <cstdlib>
+#include <vector>
+
+/* The sprite sheet
+
+A sheet is a texture cut into a grid of frames of the same size, numbered from
+left to right and top to bottom. For each frame we store what we'll write into
+the vertices: the texture coordinates of the four corners of the quad.*/
+class SpriteSheet
+{
+public:
+
+    struct Frame
+    {
+        sf::Vector2f texCoords[4];
+    };
+
+    SpriteSheet(sf::Vector2u textureSize, sf::Vector2u frameSize) :
+    m_frameSize(frameSize)
+    {
+        unsigned int columns = textureSize.x / frameSize.x;
+        unsigned int rows = textureSize.y / frameSize.y;
+
+        m_frames.resize(columns * rows);
+        for (unsigned int j = 0; j < rows; ++j)
+            for (unsigned int i = 0; i < columns; ++i)
+            {
+                float left   = static_cast<float>(i * frameSize.x);
+                float top    = static_cast<float>(j * frameSize.y);
+                float right  = static_cast<float>((i + 1) * frameSize.x);
+                float bottom = static_cast<float>((j + 1) * frameSize.y);
+
+                Frame& frame = m_frames[i + j * columns];
+                frame.texCoords[0] = sf::Vector2f(left, top);
+                frame.texCoords[1] = sf::Vector2f(right, top);
+                frame.texCoords[2] = sf::Vector2f(right, bottom);
+                frame.texCoords[3] = sf::Vector2f(left, bottom);
+            }
+    }
+
+    std::size_t getFrameCount() const
+    {
+        return m_frames.size();
+    }
+
+    const Frame& getFrame(std::size_t index) const
+    {
+        return m_frames[index];
+    }
+
+    // the same frame as a rect, for sprite.setTextureRect or a sprite batch
+    sf::IntRect getFrameRect(std::size_t index) const
+    {
+        const sf::Vector2f& topLeft = m_frames[index].texCoords[0];
+        return sf::IntRect(static_cast<int>(topLeft.x), static_cast<int>(topLeft.y),
+                           static_cast<int>(m_frameSize.x), static_cast<int>(m_frameSize.y));
+    }
+
+    sf::Vector2u getFrameSize() const
+    {
+        return m_frameSize;
+    }
+
+private:
+
+    sf::Vector2u m_frameSize;
+    std::vector<Frame> m_frames;
+};
+
+/* Clips
+
+A clip is a sequence of consecutive frames of the sheet (at least one), each
+one displayed for the same duration (which can't be zero).*/
+struct AnimationClip
+{
+    std::size_t firstFrame;
+    std::size_t frameCount;
+    sf::Time frameDuration;
+    bool loop;          // when false, the clip stops on its last frame
+};
+
+/* The animation system
+
+The animators are not objects of their own: animator number i is the i-th
+element of each array below ("structure of arrays"). Times are stored in
+microseconds, so that advancing them is a simple integer addition.
+
+Animator i writes the texture coordinates of the quad i of the vertex array
+that is passed to writeTexCoords, i.e. vertices 4 * i to 4 * i + 3.*/
+class AnimationSystem
+{
+public:
+
+    explicit AnimationSystem(const SpriteSheet& sheet) :
+    m_sheet(sheet)
+    {
+    }
+
+    // returns the identifier of the clip
+    std::size_t addClip(const AnimationClip& clip)
+    {
+        Clip compiled;
+        compiled.firstFrame = clip.firstFrame;
+        compiled.frameCount = clip.frameCount;
+        compiled.frameDuration = clip.frameDuration.asMicroseconds();
+        compiled.duration = compiled.frameDuration * static_cast<sf::Int64>(clip.frameCount);
+        compiled.loop = clip.loop;
+        m_clips.push_back(compiled);
+
+        return m_clips.size() - 1;
+    }
+
+    // returns the identifier of the animator, which is also the index of its
+    // quad in the vertex array
+    std::size_t addAnimator(std::size_t clip, sf::Time offset = sf::Time::Zero)
+    {
+        m_clip.push_back(clip);
+        m_time.push_back(offset.asMicroseconds());
+        m_frame.push_back(m_clips[clip].firstFrame);
+
+        return m_clip.size() - 1;
+    }
+
+    // switch an animator to another clip, from its first frame
+    void play(std::size_t animator, std::size_t clip)
+    {
+        m_clip[animator] = clip;
+        m_time[animator] = 0;
+        m_frame[animator] = m_clips[clip].firstFrame;
+    }
+
+    std::size_t getAnimatorCount() const
+    {
+        return m_clip.size();
+    }
+
+    std::size_t getFrame(std::size_t animator) const
+    {
+        return m_frame[animator];
+    }
+
+    // update the current frame of all the animators
+    void advance(sf::Time elapsed)
+    {
+        sf::Int64 dt = elapsed.asMicroseconds();
+        std::size_t count = m_clip.size();
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const Clip& clip = m_clips[m_clip[i]];
+            sf::Int64 time = m_time[i] + dt;
+
+            // keep looping times within the clip, so that they never overflow;
+            // stopped clips stay at their end
+            if (time >= clip.duration)
+                time = clip.loop ? time % clip.duration : clip.duration - 1;
+
+            m_time[i] = time;
+            m_frame[i] = clip.firstFrame + static_cast<std::size_t>(time / clip.frameDuration);
+        }
+    }
+
+    // write the texture coordinates of the current frames into quads, which
+    // must contain 4 vertices per animator
+    void writeTexCoords(sf::Vertex* quads) const
+    {
+        std::size_t count = m_frame.size();
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            const SpriteSheet::Frame& frame = m_sheet.getFrame(m_frame[i]);
+            sf::Vertex* quad = quads + i * 4;
+
+            quad[0].texCoords = frame.texCoords[0];
+            quad[1].texCoords = frame.texCoords[1];
+            quad[2].texCoords = frame.texCoords[2];
+            quad[3].texCoords = frame.texCoords[3];
+        }
+    }
+
+private:
+
+    struct Clip
+    {
+        std::size_t firstFrame;
+        std::size_t frameCount;
+        sf::Int64 frameDuration;
+        sf::Int64 duration;
+        bool loop;
+    };
+
+    const SpriteSheet& m_sheet;
+    std::vector<Clip> m_clips;
+
+    // one element per animator
+    std::vector<std::size_t> m_clip;
+    std::vector<sf::Int64> m_time;
+    std::vector<std::size_t> m_frame;
+};
+
+//If your sprites move, you don't have to give up on this: fill the positions
+//of the quads with a sprite batch (see the sprite batching tutorial), and pass
+//sheet.getFrameRect(system.getFrame(i)) as the texture rect of each sprite. If
+//they don't move, like in the demo below, the positions are written once and
+//only the texture coordinates are updated.
+
+//All the clips of a system use the same sheet, and therefore the same texture,
+//so all the animated sprites are still drawn with a single draw call.
+
+/* A demo with 10000 animated sprites. Our sheet has 8 frames of 32x32 pixels per
+row, one row per animation. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Sprite animation");
+
+    sf::Texture texture;
+    if (!texture.loadFromFile("character.png"))
+        return -1;
+
+    SpriteSheet sheet(texture.getSize(), sf::Vector2u(32, 32));
+    AnimationSystem animations(sheet);
+
+    AnimationClip walk = {0, 8, sf::milliseconds(100), true};
+    AnimationClip jump = {8, 6, sf::milliseconds(80), false};
+    std::size_t walkClip = animations.addClip(walk);
+    std::size_t jumpClip = animations.addClip(jump);
+
+    // a grid of 100x100 sprites, with a random phase so they don't all walk
+    // in sync
+    sf::VertexArray quads(sf::Quads);
+    for (int y = 0; y < 100; ++y)
+        for (int x = 0; x < 100; ++x)
+        {
+            animations.addAnimator(walkClip, sf::milliseconds(std::rand() % 800));
+
+            sf::Vector2f position(x * 8.f, y * 6.f);
+            quads.append(sf::Vertex(position));
+            quads.append(sf::Vertex(position + sf::Vector2f(32, 0)));
+            quads.append(sf::Vertex(position + sf::Vector2f(32, 32)));
+            quads.append(sf::Vertex(position + sf::Vector2f(0, 32)));
+        }
+
+    sf::Clock clock;
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+
+            // make a random sprite jump when space is pressed
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Space)
+                animations.play(std::rand() % animations.getAnimatorCount(), jumpClip);
+        }
+
+        // one loop to update them all, one loop to write the texture coordinates
+        animations.advance(clock.restart());
+        animations.writeTexCoords(&quads[0]);
+
+        window.clear();
+        window.draw(quads, &texture);
+        window.display();
+    }
+
+    return 0;
+}
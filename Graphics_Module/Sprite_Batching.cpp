@@ -0,0 +1,237 @@
+/* Drawing thousands of sprites with a sprite batch
+
+compile with:  g++ -c Sprite_Batching.cpp
+and then link to get the executable with:
+
+    g++ Sprite_Batching.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+Every call to window.draw(sprite) is a separate draw call: the render target
+sets up its OpenGL states, uploads the sprite's transform, binds its texture and
+finally draws two triangles. As the vertex arrays tutorial explains, you'll
+reach the limits of your graphics card very quickly this way, long before the
+GPU itself is busy.
+
+When many sprites share the same texture (an atlas, or an animation sheet),
+there's no reason to pay that price for each of them. A sprite batch collects
+the sprites of a frame into a single vertex array, with their transforms
+already applied on the CPU, and only starts a new draw call when the texture
+changes. 100000 sprites cut from one atlas are then rendered in one draw call.*/
+
+#include <SFML/Graphics.hpp>
+#include <cstdlib>
+#include <vector>
+
+/* The sprite batch
+
+The interface mimics a typical frame: begin() forgets the previous content,
+add() is called once per sprite, end() closes the batch. The batch is a
+sf::Drawable, so once it is filled it is drawn like any other entity.
+
+Its storage is never released between frames: begin() only resets the vertex
+count, so after the first frame, filling the batch doesn't allocate anything.*/
+class SpriteBatch : public sf::Drawable
+{
+public:
+
+    SpriteBatch() :
+    m_vertices(),
+    m_vertexCount(0),
+    m_batches(),
+    m_texture(NULL)
+    {
+    }
+
+    // forget the sprites of the previous frame, but keep the allocated memory
+    void begin()
+    {
+        m_vertexCount = 0;
+        m_batches.clear();
+        m_texture = NULL;
+    }
+
+    // select the texture of the next sprites; a new draw call is only
+    // started when it differs from the current one
+    void setTexture(const sf::Texture* texture)
+    {
+        if (texture == m_texture)
+            return;
+
+        closeBatch();
+        m_texture = texture;
+    }
+
+    // add a sprite showing textureRect (in pixels), transformed by transform
+    // and modulated by color
+    void add(const sf::IntRect& textureRect, const sf::Transform& transform,
+             const sf::Color& color = sf::Color::White)
+    {
+        if (m_vertexCount + 4 > m_vertices.size())
+            m_vertices.resize(m_vertices.empty() ? 4096 : m_vertices.size() * 2);
+
+        // the local quad is (0, 0, width, height), like in sf::Sprite; a
+        // negative texture rect size flips the sprite without changing its size
+        float width  = static_cast<float>(std::abs(textureRect.width));
+        float height = static_cast<float>(std::abs(textureRect.height));
+
+        // instead of calling transformPoint four times, use the columns of the
+        // matrix directly: each corner is the origin plus scaled axes
+        const float* matrix = transform.getMatrix();
+        sf::Vector2f origin(matrix[12], matrix[13]);
+        sf::Vector2f xAxis(matrix[0] * width, matrix[1] * width);
+        sf::Vector2f yAxis(matrix[4] * height, matrix[5] * height);
+
+        float left   = static_cast<float>(textureRect.left);
+        float top    = static_cast<float>(textureRect.top);
+        float right  = left + textureRect.width;
+        float bottom = top + textureRect.height;
+
+        sf::Vertex* quad = &m_vertices[m_vertexCount];
+
+        quad[0].position = origin;
+        quad[1].position = origin + xAxis;
+        quad[2].position = origin + xAxis + yAxis;
+        quad[3].position = origin + yAxis;
+
+        quad[0].texCoords = sf::Vector2f(left, top);
+        quad[1].texCoords = sf::Vector2f(right, top);
+        quad[2].texCoords = sf::Vector2f(right, bottom);
+        quad[3].texCoords = sf::Vector2f(left, bottom);
+
+        quad[0].color = color;
+        quad[1].color = color;
+        quad[2].color = color;
+        quad[3].color = color;
+
+        m_vertexCount += 4;
+    }
+
+    // add an existing sf::Sprite, with its texture, rect, transform and color
+    void add(const sf::Sprite& sprite)
+    {
+        setTexture(sprite.getTexture());
+        add(sprite.getTextureRect(), sprite.getTransform(), sprite.getColor());
+    }
+
+    // close the last batch; the sprite batch is now ready to be drawn
+    void end()
+    {
+        closeBatch();
+    }
+
+    // number of draw calls that drawing the batch will issue
+    std::size_t getDrawCallCount() const
+    {
+        return m_batches.size();
+    }
+
+    std::size_t getSpriteCount() const
+    {
+        return m_vertexCount / 4;
+    }
+
+private:
+
+    // a range of vertices that share the same texture
+    struct Batch
+    {
+        const sf::Texture* texture;
+        std::size_t first;
+        std::size_t count;
+    };
+
+    void closeBatch()
+    {
+        std::size_t first = m_batches.empty() ? 0 :
+                            m_batches.back().first + m_batches.back().count;
+
+        if (m_vertexCount > first)
+        {
+            Batch batch = {m_texture, first, m_vertexCount - first};
+            m_batches.push_back(batch);
+        }
+    }
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
+    {
+        // one draw call per texture change, the vertices are already
+        // transformed so only the caller's transform is applied
+        for (std::size_t i = 0; i < m_batches.size(); ++i)
+        {
+            states.texture = m_batches[i].texture;
+            target.draw(&m_vertices[m_batches[i].first], m_batches[i].count,
+                        sf::Quads, states);
+        }
+    }
+
+    std::vector<sf::Vertex> m_vertices;
+    std::size_t m_vertexCount;
+    std::vector<Batch> m_batches;
+    const sf::Texture* m_texture;
+};
+
+//Sort your sprites by texture before adding them (or better, put them all in
+//the same atlas): the batch only merges consecutive sprites, because reordering
+//them would change which sprite is drawn on top of which.
+
+//The transforms don't have to come from sf::Sprite objects. Any sf::Transform
+//works, which means that your game objects don't need to store a sf::Sprite at
+//all: a texture rect, a position and a color are enough.
+
+/* And a demo that draws 100000 sprites from a single atlas: */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Sprite batch");
+
+    sf::Texture atlas;
+    if (!atlas.loadFromFile("atlas.png"))
+        return -1;
+
+    // our atlas contains 8x8 tiles of 32x32 pixels
+    const std::size_t count = 100000;
+    std::vector<sf::Vector2f> positions(count);
+    std::vector<sf::IntRect> rects(count);
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        positions[i] = sf::Vector2f(static_cast<float>(std::rand() % 800),
+                                    static_cast<float>(std::rand() % 600));
+        int tile = std::rand() % 64;
+        rects[i] = sf::IntRect((tile % 8) * 32, (tile / 8) * 32, 32, 32);
+    }
+
+    SpriteBatch batch;
+    sf::Clock clock;
+    float angle = 0.f;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        angle += clock.restart().asSeconds() * 90.f;
+
+        // rebuild the batch with rotating sprites
+        batch.begin();
+        batch.setTexture(&atlas);
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            sf::Transform transform;
+            transform.translate(positions[i]).rotate(angle).translate(-16.f, -16.f);
+            batch.add(rects[i], transform);
+        }
+        batch.end();
+
+        // a single draw call for all of them
+        window.clear();
+        window.draw(batch);
+        window.display();
+    }
+
+    return 0;
+}
@@ -0,0 +1,224 @@
+/* Drawing thousands of labels with a text batch
+
+compile with:  g++ -c Text_Batching.cpp
+and then link to get the executable with:
+
+    g++ Text_Batching.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+Each sf::Text is a drawable of its own: drawing 3000 damage numbers or
+nameplates means 3000 draw calls, even though they all use the same font, the
+same character size, and therefore the same glyph texture.
+
+The fonts tutorial ends with what we need to do better: font.getTexture(size)
+gives the texture that contains all the glyphs of a character size, and
+font.getGlyph gives, for each character, where its pixels are in this texture
+and where to put them relative to the baseline. With this, we can lay out many
+strings ourselves, append all their glyph quads to a single vertex array, and
+draw all the labels at once over the glyph texture.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+#include <vector>
+
+/* The text batch
+
+The layout is the same as sf::Text's: the first baseline is one character size
+below the position, spaces and tabs only move the pen, new lines go down by the
+font's line spacing, and kerning is applied between consecutive characters.
+
+Since the glyphs are stored in the texture of a single character size, a batch
+is created for one font and one size. Bold glyphs are separate glyphs but live
+in the same texture, so bold and regular labels can be mixed. Labels can't be
+scaled by a transform without becoming blurry: to draw bigger labels, use
+another batch with a bigger character size.*/
+class TextBatch : public sf::Drawable
+{
+public:
+
+    TextBatch(const sf::Font& font, unsigned int characterSize) :
+    m_font(&font),
+    m_characterSize(characterSize),
+    m_vertexCount(0)
+    {
+    }
+
+    // forget the labels of the previous frame, but keep the allocated memory
+    void clear()
+    {
+        m_vertexCount = 0;
+    }
+
+    // add a label; position is the top-left corner of the text, like
+    // sf::Text's position
+    void add(const sf::String& string, sf::Vector2f position,
+             const sf::Color& color = sf::Color::White, bool bold = false)
+    {
+        // 6 vertices per character, which is enough even if some of them are
+        // spaces
+        std::size_t count = string.getSize();
+        if (m_vertexCount + count * 6 > m_vertices.size())
+            m_vertices.resize(std::max(m_vertices.size() * 2, m_vertexCount + count * 6));
+
+        float whitespaceWidth = m_font->getGlyph(L' ', m_characterSize, bold).advance;
+        float lineSpacing = m_font->getLineSpacing(m_characterSize);
+
+        float x = 0.f;
+        float y = static_cast<float>(m_characterSize);
+        sf::Uint32 previous = 0;
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            sf::Uint32 current = string[i];
+
+            x += m_font->getKerning(previous, current, m_characterSize);
+            previous = current;
+
+            // whitespace characters only move the pen
+            if (current == L' ')
+            {
+                x += whitespaceWidth;
+                continue;
+            }
+            if (current == L'\t')
+            {
+                x += whitespaceWidth * 4;
+                continue;
+            }
+            if (current == L'\n')
+            {
+                y += lineSpacing;
+                x = 0;
+                continue;
+            }
+
+            const sf::Glyph& glyph = m_font->getGlyph(current, m_characterSize, bold);
+            addGlyphQuad(position + sf::Vector2f(x, y), color, glyph);
+
+            x += glyph.advance;
+        }
+    }
+
+    std::size_t getVertexCount() const
+    {
+        return m_vertexCount;
+    }
+
+private:
+
+    void addGlyphQuad(sf::Vector2f position, const sf::Color& color, const sf::Glyph& glyph)
+    {
+        // like sf::Text, we add one pixel of padding around the glyph: glyphs
+        // are stored with a margin in the texture, and smoothing would
+        // otherwise cut their edges
+        float padding = 1.f;
+
+        float left   = position.x + glyph.bounds.left - padding;
+        float top    = position.y + glyph.bounds.top - padding;
+        float right  = position.x + glyph.bounds.left + glyph.bounds.width + padding;
+        float bottom = position.y + glyph.bounds.top + glyph.bounds.height + padding;
+
+        float u1 = static_cast<float>(glyph.textureRect.left) - padding;
+        float v1 = static_cast<float>(glyph.textureRect.top) - padding;
+        float u2 = static_cast<float>(glyph.textureRect.left + glyph.textureRect.width) + padding;
+        float v2 = static_cast<float>(glyph.textureRect.top + glyph.textureRect.height) + padding;
+
+        sf::Vertex* vertex = &m_vertices[m_vertexCount];
+        vertex[0] = sf::Vertex(sf::Vector2f(left, top), color, sf::Vector2f(u1, v1));
+        vertex[1] = sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1));
+        vertex[2] = sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2));
+        vertex[3] = sf::Vertex(sf::Vector2f(left, bottom), color, sf::Vector2f(u1, v2));
+        vertex[4] = sf::Vertex(sf::Vector2f(right, top), color, sf::Vector2f(u2, v1));
+        vertex[5] = sf::Vertex(sf::Vector2f(right, bottom), color, sf::Vector2f(u2, v2));
+
+        m_vertexCount += 6;
+    }
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
+    {
+        if (m_vertexCount == 0)
+            return;
+
+        // get the texture at draw time: requesting new glyphs may have made
+        // the font resize it
+        states.texture = &m_font->getTexture(m_characterSize);
+        target.draw(&m_vertices[0], m_vertexCount, sf::Triangles, states);
+    }
+
+    const sf::Font* m_font;
+    unsigned int m_characterSize;
+    std::vector<sf::Vertex> m_vertices;
+    std::size_t m_vertexCount;
+};
+
+//Note that the texture coordinates are in pixels, which is what the
+//sf::Texture that we draw with expects: even if the font enlarges its texture
+//to make room for new glyphs, the coordinates of existing glyphs stay valid.
+
+//Like sf::Text, the batch doesn't handle right-to-left scripts or complex text
+//shaping; it just places glyphs one after the other.
+
+/* A demo with 3000 floating damage numbers, all drawn with one draw call. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Text batch");
+
+    sf::Font font;
+    if (!font.loadFromFile("arial.ttf"))
+        return -1;
+
+    struct Label
+    {
+        sf::String text;
+        sf::Vector2f position;
+        sf::Color color;
+    };
+
+    std::vector<Label> labels(3000);
+    for (std::size_t i = 0; i < labels.size(); ++i)
+    {
+        std::ostringstream text;
+        text << (std::rand() % 1000);
+        labels[i].text = text.str();
+        labels[i].position = sf::Vector2f(static_cast<float>(std::rand() % 800),
+                                          static_cast<float>(std::rand() % 600));
+        labels[i].color = (i % 10 == 0) ? sf::Color::Yellow : sf::Color::Red;
+    }
+
+    TextBatch batch(font, 16);
+    sf::Clock clock;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        // the numbers float up, and come back from the bottom
+        float dy = clock.restart().asSeconds() * 30.f;
+
+        batch.clear();
+        for (std::size_t i = 0; i < labels.size(); ++i)
+        {
+            labels[i].position.y -= dy;
+            if (labels[i].position.y < -20)
+                labels[i].position.y += 620;
+
+            // critical hits in bold
+            batch.add(labels[i].text, labels[i].position, labels[i].color, i % 10 == 0);
+        }
+
+        window.clear();
+        window.draw(batch);
+        window.display();
+    }
+
+    return 0;
+}
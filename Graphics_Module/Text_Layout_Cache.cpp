@@ -0,0 +1,522 @@
+/* Updating texts that change a little at every frame
+
+compile with:  g++ -c Text_Layout_Cache.cpp
+and then link to get the executable with:
+
+    g++ Text_Layout_Cache.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+A HUD is full of texts that change all the time, but only a little: a score
+that goes from 12340 to 12350, a timer that changes its last digit, a counter
+of coins. With sf::Text, every setString throws the whole geometry away, and
+the next draw builds it again: for every character, the font is asked for the
+glyph (a lookup in the font's glyph table) and for the kerning with the
+previous character (a call to FreeType), and a quad is generated.
+
+Most of this work gives the same result as the previous frame. Two things can
+be saved:
+
+1. glyphs and kerning values never change for a given font, character size and
+   style, so they can be memoized in a glyph cache that is shared by all the
+   texts that use this font, size and style
+2. when the string changes, everything before the first changed character is
+   laid out exactly as before, and everything after the last changed character
+   is laid out as before too, just shifted; only the characters in between
+   need to be laid out again
+
+And of course, when the string doesn't change at all (setString with the same
+value, which is what most HUD code does at every frame), nothing has to be
+done.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+/* The glyph cache
+
+The glyphs of the first 256 code points (which covers digits, latin letters and
+punctuation) are stored in an array indexed by the code point, the others in a
+map. Kerning values are stored in a hash table indexed by the pair of
+characters.
+
+There's one cache per font, character size and boldness, shared by all the
+texts: GlyphCache::get returns it, and creates it the first time. Italic,
+underlined and strike-through texts use the same glyphs as regular ones, so
+they share the cache too.*/
+class GlyphCache
+{
+public:
+
+    GlyphCache(const sf::Font& font, unsigned int characterSize, bool bold) :
+    m_font(&font),
+    m_characterSize(characterSize),
+    m_bold(bold),
+    m_latin(256),
+    m_latinLoaded(256, false)
+    {
+        m_whitespaceWidth = getGlyph(L' ').advance;
+        m_lineSpacing = font.getLineSpacing(characterSize);
+    }
+
+    static GlyphCache& get(const sf::Font& font, unsigned int characterSize, bool bold)
+    {
+        // elements of a std::map never move, so the returned references stay
+        // valid when other caches are created
+        static std::map<Key, GlyphCache> caches;
+
+        Key key(&font, characterSize * 2 + (bold ? 1 : 0));
+        std::map<Key, GlyphCache>::iterator it = caches.find(key);
+        if (it == caches.end())
+            it = caches.insert(std::make_pair(key, GlyphCache(font, characterSize, bold))).first;
+
+        return it->second;
+    }
+
+    const sf::Glyph& getGlyph(sf::Uint32 codePoint)
+    {
+        if (codePoint < 256)
+        {
+            if (!m_latinLoaded[codePoint])
+            {
+                m_latin[codePoint] = m_font->getGlyph(codePoint, m_characterSize, m_bold);
+                m_latinLoaded[codePoint] = true;
+            }
+            return m_latin[codePoint];
+        }
+
+        std::map<sf::Uint32, sf::Glyph>::iterator it = m_others.find(codePoint);
+        if (it == m_others.end())
+            it = m_others.insert(std::make_pair(codePoint, m_font->getGlyph(codePoint, m_characterSize, m_bold))).first;
+
+        return it->second;
+    }
+
+    float getKerning(sf::Uint32 first, sf::Uint32 second)
+    {
+        if (first == 0)
+            return 0.f;
+
+        sf::Uint64 key = (static_cast<sf::Uint64>(first) << 32) | second;
+        std::unordered_map<sf::Uint64, float>::iterator it = m_kerning.find(key);
+        if (it == m_kerning.end())
+            it = m_kerning.insert(std::make_pair(key, m_font->getKerning(first, second, m_characterSize))).first;
+
+        return it->second;
+    }
+
+    float getWhitespaceWidth() const
+    {
+        return m_whitespaceWidth;
+    }
+
+    float getLineSpacing() const
+    {
+        return m_lineSpacing;
+    }
+
+    unsigned int getCharacterSize() const
+    {
+        return m_characterSize;
+    }
+
+    // the texture must be requested at draw time, since adding glyphs may
+    // have made the font resize it
+    const sf::Texture& getTexture() const
+    {
+        return m_font->getTexture(m_characterSize);
+    }
+
+private:
+
+    typedef std::pair<const sf::Font*, unsigned int> Key;
+
+    const sf::Font* m_font;
+    unsigned int m_characterSize;
+    bool m_bold;
+    float m_whitespaceWidth;
+    float m_lineSpacing;
+    std::vector<sf::Glyph> m_latin;
+    std::vector<bool> m_latinLoaded;
+    std::map<sf::Uint32, sf::Glyph> m_others;
+    std::unordered_map<sf::Uint64, float> m_kerning;
+};
+
+//The caches are only destroyed at exit: like the font itself, they are meant
+//to live for the whole program. Don't use them with a font that is destroyed
+//and then loaded again at another address in the middle of the program.
+
+/* The cached text
+
+CachedText is used like sf::Text (font, string, size, color, bold and italic
+styles), and like sf::Text, it updates its geometry only when it's drawn. For
+each character of the string, it remembers where the pen was before the
+character, and where its vertices start in the vertex array.
+
+When the geometry is updated, the new string is compared with the one that was
+laid out last time:
+
+- the common prefix keeps its vertices
+- the common suffix keeps its vertices too, but they are moved by the
+  difference between the old and the new pen position (only horizontally after
+  the first line break, since lines always start at x = 0); its first
+  character is laid out again anyway, since its kerning depends on the
+  character before it
+- the characters in between are laid out with the glyph cache
+
+So the glyph and kerning lookups are proportional to the size of the edit, and
+the rest of the string costs at most a copy of its vertices.*/
+class CachedText : public sf::Drawable, public sf::Transformable
+{
+public:
+
+    CachedText(const sf::Font& font, unsigned int characterSize = 30) :
+    m_font(&font),
+    m_characterSize(characterSize),
+    m_style(sf::Text::Regular),
+    m_color(sf::Color::White),
+    m_needsUpdate(false),
+    m_needsFullUpdate(true),
+    m_layoutCount(0)
+    {
+    }
+
+    void setString(const sf::String& string)
+    {
+        // same string: keep the geometry as it is
+        if (string == m_string)
+            return;
+
+        m_string = string;
+        m_needsUpdate = true;
+    }
+
+    void setFont(const sf::Font& font)
+    {
+        if (&font != m_font)
+        {
+            m_font = &font;
+            invalidate();
+        }
+    }
+
+    void setCharacterSize(unsigned int size)
+    {
+        if (size != m_characterSize)
+        {
+            m_characterSize = size;
+            invalidate();
+        }
+    }
+
+    // sf::Text::Bold and sf::Text::Italic are supported
+    void setStyle(sf::Uint32 style)
+    {
+        if (style != m_style)
+        {
+            m_style = style;
+            invalidate();
+        }
+    }
+
+    // changing the color doesn't need a new layout
+    void setFillColor(const sf::Color& color)
+    {
+        m_color = color;
+        for (std::size_t i = 0; i < m_vertices.size(); ++i)
+            m_vertices[i].color = color;
+    }
+
+    const sf::String& getString() const
+    {
+        return m_string;
+    }
+
+    // total number of characters laid out since the creation of the text,
+    // to see how much work the cache saves
+    std::size_t getLayoutCount() const
+    {
+        return m_layoutCount;
+    }
+
+private:
+
+    void invalidate()
+    {
+        m_needsUpdate = true;
+        m_needsFullUpdate = true;
+    }
+
+    void ensureGeometryUpdate() const
+    {
+        if (!m_needsUpdate && !m_needsFullUpdate)
+            return;
+
+        GlyphCache& glyphs = GlyphCache::get(*m_font, m_characterSize, (m_style & sf::Text::Bold) != 0);
+
+        const sf::String& string = m_string;
+        const sf::String& old = m_laidOutString;
+        std::size_t count = string.getSize();
+        std::size_t oldCount = old.getSize();
+
+        std::size_t prefix = 0;
+        std::size_t suffix = 0;
+
+        if (m_needsFullUpdate)
+        {
+            m_vertices.clear();
+            m_pens.assign(1, sf::Vector2f(0.f, static_cast<float>(m_characterSize)));
+            m_firstVertex.assign(1, 0);
+        }
+        else
+        {
+            std::size_t common = std::min(count, oldCount);
+            while (prefix < common && string[prefix] == old[prefix])
+                ++prefix;
+            while (suffix < common - prefix && string[count - 1 - suffix] == old[oldCount - 1 - suffix])
+                ++suffix;
+        }
+
+        // the first character of the suffix is laid out again, the others
+        // are moved
+        std::size_t moved = suffix > 0 ? suffix - 1 : 0;
+        std::size_t end = count - moved;
+
+        // save the vertices and pens of the moved characters, relative to
+        // the start of the suffix
+        if (moved > 0)
+        {
+            std::size_t oldStart = oldCount - moved;
+            m_movedVertices.assign(m_vertices.begin() + m_firstVertex[oldStart], m_vertices.end());
+            m_movedPens.assign(m_pens.begin() + oldStart, m_pens.end());
+            m_movedFirstVertex.resize(moved + 1);
+            for (std::size_t i = 0; i <= moved; ++i)
+                m_movedFirstVertex[i] = m_firstVertex[oldStart + i] - m_firstVertex[oldStart];
+        }
+
+        // keep the prefix
+        m_vertices.resize(m_firstVertex[prefix]);
+        m_pens.resize(count + 1);
+        m_firstVertex.resize(count + 1);
+
+        // lay out the changed characters
+        bool italic = (m_style & sf::Text::Italic) != 0;
+        sf::Vector2f pen = m_pens[prefix];
+        sf::Uint32 previous = prefix > 0 ? string[prefix - 1] : 0;
+
+        for (std::size_t i = prefix; i < end; ++i)
+        {
+            sf::Uint32 current = string[i];
+
+            m_pens[i] = pen;
+            m_firstVertex[i] = m_vertices.size();
+
+            pen.x += glyphs.getKerning(previous, current);
+            previous = current;
+
+            // whitespace characters only move the pen
+            if (current == L' ')
+            {
+                pen.x += glyphs.getWhitespaceWidth();
+                continue;
+            }
+            if (current == L'\t')
+            {
+                pen.x += glyphs.getWhitespaceWidth() * 4;
+                continue;
+            }
+            if (current == L'\n')
+            {
+                pen.y += glyphs.getLineSpacing();
+                pen.x = 0;
+                continue;
+            }
+
+            const sf::Glyph& glyph = glyphs.getGlyph(current);
+            addGlyphQuad(pen, glyph, italic);
+            pen.x += glyph.advance;
+        }
+
+        m_layoutCount += end - prefix;
+
+        // move the suffix
+        if (moved > 0)
+        {
+            sf::Vector2f offset = pen - m_movedPens[0];
+            std::size_t first = m_vertices.size();
+
+            for (std::size_t i = 0; i < moved; ++i)
+            {
+                m_pens[end + i] = m_movedPens[i] + offset;
+                m_firstVertex[end + i] = first + m_movedFirstVertex[i];
+
+                for (std::size_t j = m_movedFirstVertex[i]; j < m_movedFirstVertex[i + 1]; ++j)
+                {
+                    sf::Vertex vertex = m_movedVertices[j];
+                    vertex.position += offset;
+                    vertex.color = m_color;
+                    m_vertices.push_back(vertex);
+                }
+
+                // the next line starts at x = 0, like before
+                if (string[end + i] == L'\n')
+                    offset.x = 0;
+            }
+
+            pen = m_movedPens[moved] + offset;
+        }
+
+        m_pens[count] = pen;
+        m_firstVertex[count] = m_vertices.size();
+
+        m_laidOutString = m_string;
+        m_needsUpdate = false;
+        m_needsFullUpdate = false;
+    }
+
+    void addGlyphQuad(sf::Vector2f position, const sf::Glyph& glyph, bool italic) const
+    {
+        // same padding and italic shear (12 degrees) as sf::Text
+        float padding = 1.f;
+        float shear = italic ? 0.209f : 0.f;
+
+        float left   = glyph.bounds.left - padding;
+        float top    = glyph.bounds.top - padding;
+        float right  = glyph.bounds.left + glyph.bounds.width + padding;
+        float bottom = glyph.bounds.top + glyph.bounds.height + padding;
+
+        float u1 = static_cast<float>(glyph.textureRect.left) - padding;
+        float v1 = static_cast<float>(glyph.textureRect.top) - padding;
+        float u2 = static_cast<float>(glyph.textureRect.left + glyph.textureRect.width) + padding;
+        float v2 = static_cast<float>(glyph.textureRect.top + glyph.textureRect.height) + padding;
+
+        float x = position.x;
+        float y = position.y;
+
+        sf::Vertex topLeft(sf::Vector2f(x + left - shear * top, y + top), m_color, sf::Vector2f(u1, v1));
+        sf::Vertex topRight(sf::Vector2f(x + right - shear * top, y + top), m_color, sf::Vector2f(u2, v1));
+        sf::Vertex bottomLeft(sf::Vector2f(x + left - shear * bottom, y + bottom), m_color, sf::Vector2f(u1, v2));
+        sf::Vertex bottomRight(sf::Vector2f(x + right - shear * bottom, y + bottom), m_color, sf::Vector2f(u2, v2));
+
+        m_vertices.push_back(topLeft);
+        m_vertices.push_back(topRight);
+        m_vertices.push_back(bottomLeft);
+        m_vertices.push_back(bottomLeft);
+        m_vertices.push_back(topRight);
+        m_vertices.push_back(bottomRight);
+    }
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
+    {
+        ensureGeometryUpdate();
+
+        if (m_vertices.empty())
+            return;
+
+        states.transform *= getTransform();
+        states.texture = &GlyphCache::get(*m_font, m_characterSize, (m_style & sf::Text::Bold) != 0).getTexture();
+        target.draw(&m_vertices[0], m_vertices.size(), sf::Triangles, states);
+    }
+
+    const sf::Font* m_font;
+    unsigned int m_characterSize;
+    sf::Uint32 m_style;
+    sf::Color m_color;
+    sf::String m_string;
+
+    // the geometry, updated when the text is drawn
+    mutable sf::String m_laidOutString;
+    mutable std::vector<sf::Vertex> m_vertices;
+    mutable std::vector<sf::Vector2f> m_pens;        // one per character, plus the end
+    mutable std::vector<std::size_t> m_firstVertex;  // one per character, plus the end
+    mutable bool m_needsUpdate;
+    mutable bool m_needsFullUpdate;
+    mutable std::size_t m_layoutCount;
+
+    // scratch buffers for the moved suffix, kept to avoid allocations
+    mutable std::vector<sf::Vertex> m_movedVertices;
+    mutable std::vector<sf::Vector2f> m_movedPens;
+    mutable std::vector<std::size_t> m_movedFirstVertex;
+};
+
+//Underlines and strike-throughs are left out: they're one rectangle per line,
+//which sf::Text computes from font.getUnderlinePosition and
+//font.getUnderlineThickness, and are cheap to rebuild.
+
+//Each cached text is still drawn with its own draw call. If you have hundreds
+//of labels that share a font and a size, combine this with the text batching
+//tutorial: the glyph cache works the same way there.
+
+/* A demo with 300 counters, most of which change by a small amount at every
+frame. The console shows how many characters are laid out each second,
+compared with what sf::Text would lay out. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Text layout cache");
+
+    sf::Font font;
+    if (!font.loadFromFile("arial.ttf"))
+        return -1;
+
+    std::vector<CachedText> texts;
+    std::vector<long> values(300);
+    for (std::size_t i = 0; i < values.size(); ++i)
+    {
+        values[i] = std::rand() % 100000;
+        texts.push_back(CachedText(font, 14));
+        texts.back().setPosition(static_cast<float>(i % 6) * 130.f + 10.f,
+                                 static_cast<float>(i / 6) * 12.f);
+    }
+
+    sf::Clock report;
+    std::size_t characters = 0;
+    std::size_t laidOut = 0;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        for (std::size_t i = 0; i < texts.size(); ++i)
+        {
+            // a third of the counters don't change at all
+            if (i % 3 != 0)
+                values[i] += std::rand() % 5;
+
+            std::ostringstream string;
+            string << "Score: " << values[i] << " pts";
+            texts[i].setString(string.str());
+            characters += texts[i].getString().getSize();
+        }
+
+        window.clear();
+        for (std::size_t i = 0; i < texts.size(); ++i)
+            window.draw(texts[i]);
+        window.display();
+
+        if (report.getElapsedTime() > sf::seconds(1))
+        {
+            std::size_t total = 0;
+            for (std::size_t i = 0; i < texts.size(); ++i)
+                total += texts[i].getLayoutCount();
+
+            std::cout << total - laidOut << " characters laid out, instead of "
+                      << characters << std::endl;
+            laidOut = total;
+            characters = 0;
+            report.restart();
+        }
+    }
+
+    return 0;
+}
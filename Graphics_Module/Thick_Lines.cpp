@@ -0,0 +1,270 @@
+/* Drawing thick lines and polylines
+
+compile with:  g++ -O3 -fno-math-errno -c Thick_Lines.cpp
+and then link to get the executable with:
+
+    g++ Thick_Lines.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+The shapes tutorial gives two ways to draw a line: a rotated sf::RectangleShape
+if it has a thickness, a sf::Lines vertex array of 2 points if it doesn't. Both
+are fine for a few lines, but each line is then a separate object, drawn with
+a separate draw call. And a path made of rectangles shows gaps and overlaps at
+its corners, since the rectangles don't know about each other.
+
+Graphs, paths and debug traces are better described as polylines: sequences of
+connected points. A polyline of n points becomes a single triangle strip of
+about 2n vertices: two vertices per point, offset on each side of the line by
+half its thickness. At each corner, the two offset edges are joined either with
+a miter (they are extended until they meet) or, when the corner is too sharp
+and the miter would be too long, with a bevel (the corner is cut).
+
+Several polylines can go into the same strip: between two polylines we repeat
+the last vertex of the first one and the first vertex of the next one. This
+creates degenerate triangles -- triangles with no area, which draw nothing --
+and lets a single draw call render a whole plot of 100000 segments.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/* The polyline batch
+
+The vertices are generated in two passes. The first one computes the normal of
+every segment: it has no branches and works on contiguous arrays, so an
+optimizing compiler can turn it into SIMD code. The second one, which handles
+joins and caps, is cheap in comparison.
+
+Two compiler options are needed for the first pass. -O3 enables the
+vectorizer. -fno-math-errno is needed because, by default, std::sqrt must set
+errno for a negative argument: the compiler keeps a call to the library
+function for that case, and a loop with such a branch is not vectorized.
+Without errno, std::sqrt is a single instruction. The option has no other
+effect, unlike -ffast-math, which also changes the results of computations.*/
+class PolylineBatch : public sf::Drawable
+{
+public:
+
+    enum Join
+    {
+        MiterJoin, // sharp corners (falling back to bevels beyond the limit)
+        BevelJoin  // cut corners
+    };
+
+    enum Cap
+    {
+        ButtCap,   // the line stops exactly at its end points
+        SquareCap  // the line is extended by half its thickness
+    };
+
+    PolylineBatch() :
+    m_vertexCount(0)
+    {
+    }
+
+    // forget the lines of the previous frame, but keep the allocated memory
+    void clear()
+    {
+        m_vertexCount = 0;
+    }
+
+    // add a polyline; miterLimit is the maximum length of a miter, relative
+    // to the thickness of the line
+    void add(const sf::Vector2f* points, std::size_t count, float thickness,
+             const sf::Color& color, Join join = MiterJoin, Cap cap = ButtCap,
+             float miterLimit = 4.f)
+    {
+        // remove repeated points, which would give segments without direction
+        m_points.clear();
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (m_points.empty() || points[i] != m_points.back())
+                m_points.push_back(points[i]);
+        }
+
+        count = m_points.size();
+        if (count < 2)
+            return;
+
+        computeNormals();
+
+        float halfThickness = thickness / 2.f;
+        float limit = miterLimit * miterLimit;
+
+        // worst case: 2 vertices per point, 2 more per bevel, 2 to connect to
+        // the previous polyline
+        reserve(count * 4 + 2);
+
+        sf::Vector2f start = m_points[0];
+        if (cap == SquareCap)
+            start -= direction(0) * halfThickness;
+
+        // connect to the previous polyline with degenerate triangles: repeat
+        // its last vertex, then our first one
+        if (m_vertexCount > 0)
+        {
+            m_vertices[m_vertexCount] = m_vertices[m_vertexCount - 1];
+            m_vertices[m_vertexCount + 1] = sf::Vertex(start + m_normals[0] * halfThickness, color);
+            m_vertexCount += 2;
+        }
+
+        // start cap
+        appendPair(start, m_normals[0] * halfThickness, color);
+
+        // joins
+        for (std::size_t i = 1; i + 1 < count; ++i)
+        {
+            sf::Vector2f previous = m_normals[i - 1];
+            sf::Vector2f next = m_normals[i];
+
+            // the miter is along the sum of the normals, and its length is
+            // 1 / cos(angle / 2); this is the same formula as sf::Shape uses
+            // for outlines
+            float factor = 1.f + previous.x * next.x + previous.y * next.y;
+            sf::Vector2f miter = (previous + next) / factor;
+            float length = miter.x * miter.x + miter.y * miter.y;
+
+            if (join == MiterJoin && factor > 0.0001f && length <= limit)
+            {
+                appendPair(m_points[i], miter * halfThickness, color);
+            }
+            else
+            {
+                appendPair(m_points[i], previous * halfThickness, color);
+                appendPair(m_points[i], next * halfThickness, color);
+            }
+        }
+
+        // end cap
+        sf::Vector2f end = m_points[count - 1];
+        if (cap == SquareCap)
+            end += direction(count - 2) * halfThickness;
+        appendPair(end, m_normals[count - 2] * halfThickness, color);
+    }
+
+    void add(const std::vector<sf::Vector2f>& points, float thickness,
+             const sf::Color& color, Join join = MiterJoin, Cap cap = ButtCap,
+             float miterLimit = 4.f)
+    {
+        if (!points.empty())
+            add(&points[0], points.size(), thickness, color, join, cap, miterLimit);
+    }
+
+    std::size_t getVertexCount() const
+    {
+        return m_vertexCount;
+    }
+
+private:
+
+    // normal of each segment, pointing to its left
+    void computeNormals()
+    {
+        std::size_t count = m_points.size() - 1;
+        m_normals.resize(count);
+
+        const sf::Vector2f* points = &m_points[0];
+        sf::Vector2f* normals = &m_normals[0];
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            float dx = points[i + 1].x - points[i].x;
+            float dy = points[i + 1].y - points[i].y;
+            float inverseLength = 1.f / std::sqrt(dx * dx + dy * dy);
+            normals[i].x = -dy * inverseLength;
+            normals[i].y = dx * inverseLength;
+        }
+    }
+
+    // direction of a segment, deduced from its normal
+    sf::Vector2f direction(std::size_t segment) const
+    {
+        return sf::Vector2f(m_normals[segment].y, -m_normals[segment].x);
+    }
+
+    void reserve(std::size_t count)
+    {
+        if (m_vertexCount + count > m_vertices.size())
+            m_vertices.resize(std::max(m_vertices.size() * 2, m_vertexCount + count));
+    }
+
+    void appendPair(sf::Vector2f point, sf::Vector2f offset, const sf::Color& color)
+    {
+        m_vertices[m_vertexCount++] = sf::Vertex(point + offset, color);
+        m_vertices[m_vertexCount++] = sf::Vertex(point - offset, color);
+    }
+
+    virtual void draw(sf::RenderTarget& target, sf::RenderStates states) const
+    {
+        if (m_vertexCount == 0)
+            return;
+
+        states.texture = NULL;
+        target.draw(&m_vertices[0], m_vertexCount, sf::TriangleStrip, states);
+    }
+
+    std::vector<sf::Vertex> m_vertices;
+    std::size_t m_vertexCount;
+
+    // scratch buffers, kept to avoid allocations
+    std::vector<sf::Vector2f> m_points;
+    std::vector<sf::Vector2f> m_normals;
+};
+
+//The bevel join adds a pair of vertices at the corner, so the inner side of a
+//bevelled corner overlaps itself a little. With opaque colors it's invisible;
+//with transparent colors the overlap is slightly darker.
+
+//For thin lines (1 pixel or less), the offset edges get closer than a pixel
+//and the line may look dotted; use a sf::LineStrip vertex array for them.
+
+/* A demo that plots a curve of 100000 segments, plus a few thick paths, in a
+single draw call. */
+int main()
+{
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Thick lines");
+
+    std::vector<sf::Vector2f> plot(100001);
+
+    std::vector<sf::Vector2f> path;
+    path.push_back(sf::Vector2f(100, 100));
+    path.push_back(sf::Vector2f(300, 150));
+    path.push_back(sf::Vector2f(200, 300));
+    path.push_back(sf::Vector2f(400, 320));
+
+    PolylineBatch lines;
+    sf::Clock clock;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        // an animated curve
+        float time = clock.getElapsedTime().asSeconds();
+        for (std::size_t i = 0; i < plot.size(); ++i)
+        {
+            float x = i * 800.f / (plot.size() - 1);
+            plot[i] = sf::Vector2f(x, 450 + std::sin(x * 0.05f + time) * 50 +
+                                               std::sin(x * 1.3f) * 10);
+        }
+
+        lines.clear();
+        lines.add(plot, 2, sf::Color::Green);
+        lines.add(path, 20, sf::Color::Red, PolylineBatch::MiterJoin, PolylineBatch::SquareCap);
+        lines.add(path, 6, sf::Color::Yellow, PolylineBatch::BevelJoin);
+
+        window.clear();
+        window.draw(lines);
+        window.display();
+    }
+
+    return 0;
+}
@@ -0,0 +1,563 @@
+/* Logging without slowing down the threads
+
+compile with:  g++ -std=c++11 -O2 -c Async_Logging.cpp
+and then link to get the executable with:
+
+    g++ Async_Logging.o -o sfml-app -lsfml-system -pthread
+*/
+
+/* Introduction
+
+The mutex example of the threads tutorial protects std::cout with a sf::Mutex,
+so that the lines of two threads don't get mixed. Logging from many threads
+this way has a cost that shows up in profiles:
+
+- every thread that logs takes the same mutex, so threads wait for each other
+- while it holds the mutex, a thread formats its line and writes it to the
+  console or a file, which is slow
+- std::endl flushes the stream, which means a system call for every line
+
+The logger below moves all the slow work to a background thread. A log call
+only copies the format string's address and the values of the arguments into
+a buffer that belongs to the calling thread; the background thread reads the
+buffers of all the threads, formats the lines, and writes them in big batches.
+
+    logger.log("loaded {} textures in {} ms", count, time);
+
+Each thread has its own buffer, a single producer, single consumer ring as in
+the lock-free queues tutorial: a log call never takes a lock, and never waits.
+If a thread logs faster than the background thread writes, and its buffer is
+full, the message is dropped (and counted), rather than blocking the thread.*/
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/* The records
+
+A record is one call to log, as it is stored in the buffer: the time, the
+address of the format string, and the arguments. Formatting happens later, in
+the background thread, which is why the format must be a string literal: the
+logger keeps its address, not a copy. The arguments are copied, strings
+included (they are truncated if they don't fit in the record): the caller may
+modify or destroy them right after the call.
+
+A record takes 128 bytes, two cache lines.*/
+namespace logging
+{
+    const std::size_t MaxArguments = 4;
+
+    struct Argument
+    {
+        enum Type
+        {
+            Signed,
+            Unsigned,
+            Float,
+            Text     // the text is stored in Record::text
+        };
+
+        Type type;
+        union
+        {
+            sf::Int64 signedValue;
+            sf::Uint64 unsignedValue;
+            double floatValue;
+            struct
+            {
+                sf::Uint16 offset;
+                sf::Uint16 length;
+            } text;
+        };
+    };
+
+    struct Record
+    {
+        sf::Uint64 time;           // nanoseconds since the logger started
+        const char* format;
+        sf::Uint32 argumentCount;
+        sf::Uint32 textSize;
+        Argument arguments[MaxArguments];
+        char text[40];
+    };
+
+    // store the value of an argument in a record
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && std::is_signed<T>::value>::type
+    store(Record& record, Argument& argument, T value)
+    {
+        (void)record;
+        argument.type = Argument::Signed;
+        argument.signedValue = value;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_integral<T>::value && !std::is_signed<T>::value>::type
+    store(Record& record, Argument& argument, T value)
+    {
+        (void)record;
+        argument.type = Argument::Unsigned;
+        argument.unsignedValue = value;
+    }
+
+    template <typename T>
+    typename std::enable_if<std::is_floating_point<T>::value>::type
+    store(Record& record, Argument& argument, T value)
+    {
+        (void)record;
+        argument.type = Argument::Float;
+        argument.floatValue = value;
+    }
+
+    inline void storeText(Record& record, Argument& argument, const char* text, std::size_t length)
+    {
+        length = std::min(length, sizeof(record.text) - record.textSize);
+        std::memcpy(record.text + record.textSize, text, length);
+
+        argument.type = Argument::Text;
+        argument.text.offset = static_cast<sf::Uint16>(record.textSize);
+        argument.text.length = static_cast<sf::Uint16>(length);
+        record.textSize += static_cast<sf::Uint32>(length);
+    }
+
+    inline void store(Record& record, Argument& argument, char value)
+    {
+        storeText(record, argument, &value, 1);
+    }
+
+    inline void store(Record& record, Argument& argument, const char* value)
+    {
+        storeText(record, argument, value, std::strlen(value));
+    }
+
+    inline void store(Record& record, Argument& argument, const std::string& value)
+    {
+        storeText(record, argument, value.data(), value.size());
+    }
+
+    inline void storeAll(Record&)
+    {
+    }
+
+    template <typename T, typename... Args>
+    void storeAll(Record& record, const T& value, const Args&... others)
+    {
+        store(record, record.arguments[record.argumentCount++], value);
+        storeAll(record, others...);
+    }
+
+    // replace each {} of the format with the next argument
+    inline void format(const Record& record, std::string& output)
+    {
+        char number[32];
+        std::size_t next = 0;
+
+        for (const char* c = record.format; *c; ++c)
+        {
+            if (c[0] != '{' || c[1] != '}' || next == record.argumentCount)
+            {
+                output += *c;
+                continue;
+            }
+
+            const Argument& argument = record.arguments[next++];
+            switch (argument.type)
+            {
+                case Argument::Signed:
+                    std::snprintf(number, sizeof(number), "%lld", static_cast<long long>(argument.signedValue));
+                    output += number;
+                    break;
+
+                case Argument::Unsigned:
+                    std::snprintf(number, sizeof(number), "%llu", static_cast<unsigned long long>(argument.unsignedValue));
+                    output += number;
+                    break;
+
+                case Argument::Float:
+                    std::snprintf(number, sizeof(number), "%g", argument.floatValue);
+                    output += number;
+                    break;
+
+                case Argument::Text:
+                    output.append(record.text + argument.text.offset, argument.text.length);
+                    break;
+            }
+
+            ++c;
+        }
+    }
+}
+
+/* The thread buffers
+
+A buffer is a ring of records, written by its thread and read by the
+background thread. Unlike the queues of the lock-free queues tutorial, the
+record is written in place: beginWrite gives the free slot, the caller fills
+it, and endWrite publishes it. Same thing on the reading side.
+
+When a thread ends, its buffer is not destroyed (the background thread may
+still have records to read in it), it is only marked as unused, and the next
+thread which logs takes it.*/
+namespace logging
+{
+    const std::size_t CacheLineSize = 64;
+
+    class ThreadBuffer : sf::NonCopyable
+    {
+    public:
+
+        ThreadBuffer(std::size_t capacity, unsigned int threadIndex) :
+        inUse(true),
+        dropped(0),
+        index(threadIndex),
+        m_records(capacity),
+        m_head(0),
+        m_tail(0)
+        {
+        }
+
+        // writer side: NULL when the buffer is full
+        Record* beginWrite()
+        {
+            std::size_t tail = m_tail.load(std::memory_order_relaxed);
+            if (tail - m_head.load(std::memory_order_acquire) == m_records.size())
+                return NULL;
+
+            return &m_records[tail % m_records.size()];
+        }
+
+        void endWrite()
+        {
+            m_tail.store(m_tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // reader side: NULL when the buffer is empty
+        const Record* beginRead()
+        {
+            std::size_t head = m_head.load(std::memory_order_relaxed);
+            if (head == m_tail.load(std::memory_order_acquire))
+                return NULL;
+
+            return &m_records[head % m_records.size()];
+        }
+
+        void endRead()
+        {
+            m_head.store(m_head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        std::atomic<bool> inUse;
+        std::atomic<sf::Uint64> dropped;   // records that didn't fit
+        const unsigned int index;          // printed in each line
+
+    private:
+
+        std::vector<Record> m_records;
+        alignas(CacheLineSize) std::atomic<std::size_t> m_head;
+        alignas(CacheLineSize) std::atomic<std::size_t> m_tail;
+    };
+}
+
+/* The logger
+
+Each thread finds its buffer through a thread_local variable. The first call to
+log from a thread registers it: this is the only place where the logger takes
+its mutex, along with the background thread which takes it once per batch to
+see the list of buffers. A thread can log to several loggers (a game log and
+a network log, for example): the thread_local variable keeps one buffer per
+logger, for up to MaxLoggersPerThread loggers.
+
+The background thread reads all the buffers, formats the records into a
+string, and writes the string with a single fwrite, followed by a single
+fflush. When there's nothing to write, it sleeps for a millisecond: the
+logger adds at most this delay to the messages, and costs nothing when there
+are none. The destructor writes everything that was logged before it is
+called.*/
+class AsyncLogger : sf::NonCopyable
+{
+public:
+
+    // the file is opened in append mode; an empty filename means the standard
+    // output; capacity is the number of records of each thread buffer
+    explicit AsyncLogger(const std::string& filename = "", std::size_t capacity = 4096) :
+    m_file(filename.empty() ? stdout : std::fopen(filename.c_str(), "a")),
+    m_capacity(capacity),
+    m_id(++s_lastId),
+    m_start(std::chrono::steady_clock::now()),
+    m_stop(false)
+    {
+        m_writer = std::thread(&AsyncLogger::write, this);
+    }
+
+    ~AsyncLogger()
+    {
+        m_stop = true;
+        m_writer.join();
+
+        if (m_file && m_file != stdout)
+            std::fclose(m_file);
+    }
+
+    bool isOpen() const
+    {
+        return m_file != NULL;
+    }
+
+    // the format must be a string literal; each {} is replaced with the next
+    // argument (integers, floating point numbers, strings)
+    template <std::size_t N, typename... Args>
+    void log(const char (&format)[N], const Args&... arguments)
+    {
+        static_assert(sizeof...(Args) <= logging::MaxArguments, "too many arguments for a log call");
+
+        logging::ThreadBuffer& buffer = getThreadBuffer();
+        logging::Record* record = buffer.beginWrite();
+        if (!record)
+        {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        record->time = static_cast<sf::Uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count());
+        record->format = format;
+        record->argumentCount = 0;
+        record->textSize = 0;
+        logging::storeAll(*record, arguments...);
+
+        buffer.endWrite();
+    }
+
+private:
+
+    static const std::size_t MaxLoggersPerThread = 4;
+
+    // the buffer of the calling thread, registered on its first call
+    logging::ThreadBuffer& getThreadBuffer()
+    {
+        // the shared pointers keep the buffers alive for the destructor of the
+        // thread_local variable, even if their logger is destroyed first
+        struct Local
+        {
+            struct Entry
+            {
+                Entry() : loggerId(0) {}
+
+                unsigned int loggerId;
+                std::shared_ptr<logging::ThreadBuffer> buffer;
+            };
+
+            Local() : next(0) {}
+
+            ~Local()
+            {
+                for (std::size_t i = 0; i < MaxLoggersPerThread; ++i)
+                {
+                    if (entries[i].buffer)
+                        entries[i].buffer->inUse.store(false, std::memory_order_release);
+                }
+            }
+
+            Entry entries[MaxLoggersPerThread];
+            std::size_t next; // the entry to replace when they are all used
+        };
+
+        thread_local Local local;
+        for (std::size_t i = 0; i < MaxLoggersPerThread; ++i)
+        {
+            if (local.entries[i].loggerId == m_id)
+                return *local.entries[i].buffer;
+        }
+
+        // a new logger for this thread: take the next entry; with more than
+        // MaxLoggersPerThread loggers, the buffer of the oldest one is given
+        // back, and that logger registers the thread again on its next call
+        Local::Entry& entry = local.entries[local.next];
+        local.next = (local.next + 1) % MaxLoggersPerThread;
+
+        if (entry.buffer)
+            entry.buffer->inUse.store(false, std::memory_order_release);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        entry.loggerId = m_id;
+        entry.buffer.reset();
+
+        // reuse the buffer of a thread which has ended
+        for (std::size_t i = 0; i < m_buffers.size() && !entry.buffer; ++i)
+        {
+            bool unused = false;
+            if (m_buffers[i]->inUse.compare_exchange_strong(unused, true, std::memory_order_acquire))
+                entry.buffer = m_buffers[i];
+        }
+
+        if (!entry.buffer)
+        {
+            entry.buffer = std::make_shared<logging::ThreadBuffer>(m_capacity, static_cast<unsigned int>(m_buffers.size()));
+            m_buffers.push_back(entry.buffer);
+        }
+
+        return *entry.buffer;
+    }
+
+    // the function of the background thread
+    void write()
+    {
+        std::vector<std::shared_ptr<logging::ThreadBuffer> > buffers;
+        std::string text;
+        char prefix[64];
+
+        while (true)
+        {
+            // read the flag before the buffers: what was logged before the
+            // destructor was called is written before the thread stops
+            bool stop = m_stop;
+
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                buffers = m_buffers;
+            }
+
+            text.clear();
+            for (std::size_t i = 0; i < buffers.size(); ++i)
+            {
+                logging::ThreadBuffer& buffer = *buffers[i];
+                while (const logging::Record* record = buffer.beginRead())
+                {
+                    std::snprintf(prefix, sizeof(prefix), "[%10.6f] [thread %u] ", record->time / 1e9, buffer.index);
+                    text += prefix;
+                    logging::format(*record, text);
+                    text += '\n';
+                    buffer.endRead();
+                }
+
+                sf::Uint64 dropped = buffer.dropped.exchange(0, std::memory_order_relaxed);
+                if (dropped > 0)
+                {
+                    std::snprintf(prefix, sizeof(prefix), "[thread %u] %llu messages dropped\n", buffer.index,
+                                  static_cast<unsigned long long>(dropped));
+                    text += prefix;
+                }
+            }
+
+            if (!text.empty() && m_file)
+            {
+                std::fwrite(text.data(), 1, text.size(), m_file);
+                std::fflush(m_file);
+            }
+            else if (stop)
+            {
+                return;
+            }
+            else
+            {
+                sf::sleep(sf::milliseconds(1));
+            }
+        }
+    }
+
+    static std::atomic<unsigned int> s_lastId;
+
+    std::FILE* m_file;
+    std::size_t m_capacity;
+    unsigned int m_id;      // tells the thread_local variables which logger they refer to
+    std::chrono::steady_clock::time_point m_start;
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<logging::ThreadBuffer> > m_buffers;
+    std::atomic<bool> m_stop;
+    std::thread m_writer;
+};
+
+std::atomic<unsigned int> AsyncLogger::s_lastId(0);
+
+//The lines of different threads are written buffer after buffer, so they are
+//not exactly in time order; the timestamp at the beginning of each line gives
+//the real order.
+
+//The formats and the arguments are copied as they are, so a log call costs
+//about as much as writing 128 bytes to memory, plus reading the clock. The
+//text is built later, on another core; the only thing the logging threads pay
+//for is the size of their buffer.
+
+//The first call to log from a thread allocates its buffer, which takes much
+//longer than the other calls; this happens once per logger. Threads which
+//must never wait, like an audio thread, should log once to each of their
+//loggers when they start.
+
+/* Benchmark
+
+Four threads log 200000 messages each, first with a sf::Mutex around an
+std::ofstream and std::endl, as in the threads tutorial, then with the
+asynchronous logger. We measure the average and the worst duration of a log
+call, as seen by the threads that log. If the background thread can't keep up
+and messages are dropped, the number of dropped messages is written to
+async.log.*/
+sf::Mutex mutex;
+std::ofstream file;
+
+void logWithMutex(int thread, int i, double value)
+{
+    sf::Lock lock(mutex);
+    file << "thread " << thread << ": message " << i << ", value " << value << std::endl;
+}
+
+template <typename Function>
+void benchmark(const char* name, Function function)
+{
+    const int threadCount = 4;
+    const int messageCount = 200000;
+
+    std::vector<std::thread> threads;
+    std::vector<sf::Int64> total(threadCount, 0);
+    std::vector<sf::Int64> worst(threadCount, 0);
+
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.push_back(std::thread([&, t]()
+        {
+            for (int i = 0; i < messageCount; ++i)
+            {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                function(t, i, i * 0.5);
+                sf::Int64 duration = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+                total[t] += duration;
+                worst[t] = std::max(worst[t], duration);
+            }
+        }));
+    }
+
+    for (std::size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    sf::Int64 sum = 0;
+    for (int t = 0; t < threadCount; ++t)
+        sum += total[t];
+
+    std::cout << name << sum / (threadCount * messageCount) << " ns per call on average, "
+              << *std::max_element(worst.begin(), worst.end()) / 1000 << " us at worst" << std::endl;
+}
+
+int main()
+{
+    file.open("mutex.log");
+    benchmark("sf::Mutex + std::endl: ", &logWithMutex);
+
+    AsyncLogger logger("async.log", 64 * 1024);
+    benchmark("AsyncLogger:           ", [&logger](int thread, int i, double value)
+    {
+        logger.log("thread {}: message {}, value {}", thread, i, value);
+    });
+
+    return 0;
+}
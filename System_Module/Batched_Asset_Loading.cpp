@@ -0,0 +1,707 @@
+/* Loading many files at once with io_uring
+
+compile with:  g++ -std=c++11 -O2 -c Batched_Asset_Loading.cpp
+and then link to get the executable with:
+
+    g++ Batched_Asset_Loading.o -o sfml-app -lsfml-graphics -lsfml-system -pthread
+*/
+
+/* Introduction
+
+Loading a level usually means loading a list of files, one after the other:
+
+    for (std::size_t i = 0; i < paths.size(); ++i)
+        images[i].loadFromFile(paths[i]);
+
+Each read waits for the disk before the next one is even requested. An NVMe
+drive can serve dozens of requests at the same time, but here it always has a
+single one to work on, and most of its bandwidth is wasted. The same goes for
+a network drive, where each request waits for a round trip.
+
+io_uring is the Linux interface for asynchronous I/O (kernel 5.6 and later).
+The program and the kernel share two ring buffers: the program writes its
+requests (read this file, at this offset, into this buffer) to the submission
+queue, and the kernel writes their results to the completion queue. A single
+system call submits a whole batch of requests and waits for results.
+
+The loader below reads all the files of a manifest this way, keeping many
+reads in flight at all times. Each file is handed to a callback as soon as it
+is complete, while the kernel keeps reading the others: decoding overlaps with
+reading.
+
+There is no wrapper library here (liburing): the three system calls and the
+structures of <linux/io_uring.h> are used directly, which is not much code.
+When io_uring is not available (older kernels, or sandboxes which forbid it),
+the loader falls back to a few threads doing blocking reads in parallel, which
+also keeps several requests in flight.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* The ring
+
+The class below maps the two queues in our memory and gives three operations:
+push a read request, submit the pushed requests (and optionally wait for
+completions), and pop a completion.
+
+The kernel reads the tail of the submission queue and writes the tail of the
+completion queue from another context, so these indices are accessed with
+atomic loads and stores, with the acquire/release ordering that the io_uring
+documentation asks for.*/
+class IoUring : sf::NonCopyable
+{
+public:
+
+    IoUring() :
+    m_fd(-1),
+    m_ringSize(0),
+    m_ring(NULL),
+    m_completionRingSize(0),
+    m_completionRing(NULL),
+    m_entries(NULL),
+    m_pending(0)
+    {
+    }
+
+    ~IoUring()
+    {
+        if (m_entries)
+            munmap(m_entries, m_parameters.sq_entries * sizeof(io_uring_sqe));
+        if (m_completionRing)
+            munmap(m_completionRing, m_completionRingSize);
+        if (m_ring)
+            munmap(m_ring, m_ringSize);
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+
+    bool create(unsigned int entries)
+    {
+        std::memset(&m_parameters, 0, sizeof(m_parameters));
+        m_fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &m_parameters));
+        if (m_fd < 0)
+            return false;
+
+        // io_uring exists since kernel 5.1, but IORING_OP_READ only since
+        // 5.6: on older kernels, every read would fail with EINVAL. 5.6 also
+        // introduced IORING_FEAT_RW_CUR_POS, so this flag tells us whether
+        // the kernel is recent enough
+        if ((m_parameters.features & IORING_FEAT_RW_CUR_POS) == 0)
+            return false;
+
+        // the submission ring (indices and array of entry indices), the
+        // completion ring (indices and completions), and the submission
+        // entries themselves; recent kernels map both rings at once
+        m_ringSize = m_parameters.sq_off.array + m_parameters.sq_entries * sizeof(unsigned int);
+        m_completionRingSize = m_parameters.cq_off.cqes + m_parameters.cq_entries * sizeof(io_uring_cqe);
+        bool singleMapping = (m_parameters.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (singleMapping)
+            m_ringSize = std::max(m_ringSize, m_completionRingSize);
+
+        m_ring = map(m_ringSize, IORING_OFF_SQ_RING);
+        if (!m_ring)
+            return false;
+
+        if (singleMapping)
+        {
+            m_completionRing = NULL;
+            m_completionRingSize = 0;
+        }
+        else
+        {
+            m_completionRing = map(m_completionRingSize, IORING_OFF_CQ_RING);
+            if (!m_completionRing)
+                return false;
+        }
+
+        m_entries = static_cast<io_uring_sqe*>(map(m_parameters.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+        if (!m_entries)
+            return false;
+
+        char* completion = static_cast<char*>(m_completionRing ? m_completionRing : m_ring);
+        char* submission = static_cast<char*>(m_ring);
+        m_submissionTail = reinterpret_cast<unsigned int*>(submission + m_parameters.sq_off.tail);
+        m_submissionMask = *reinterpret_cast<unsigned int*>(submission + m_parameters.sq_off.ring_mask);
+        m_submissionArray = reinterpret_cast<unsigned int*>(submission + m_parameters.sq_off.array);
+        m_completionHead = reinterpret_cast<unsigned int*>(completion + m_parameters.cq_off.head);
+        m_completionTail = reinterpret_cast<unsigned int*>(completion + m_parameters.cq_off.tail);
+        m_completionMask = *reinterpret_cast<unsigned int*>(completion + m_parameters.cq_off.ring_mask);
+        m_completions = reinterpret_cast<io_uring_cqe*>(completion + m_parameters.cq_off.cqes);
+
+        return true;
+    }
+
+    unsigned int getCapacity() const
+    {
+        return m_parameters.sq_entries;
+    }
+
+    // the number of requests pushed but not submitted yet
+    unsigned int getPendingCount() const
+    {
+        return m_pending;
+    }
+
+    // the caller must not have more requests in flight than getCapacity()
+    void pushRead(int file, void* buffer, unsigned int size, sf::Uint64 offset, sf::Uint64 userData)
+    {
+        unsigned int tail = *m_submissionTail;
+        unsigned int index = tail & m_submissionMask;
+
+        io_uring_sqe& entry = m_entries[index];
+        std::memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_READ;
+        entry.fd = file;
+        entry.addr = reinterpret_cast<sf::Uint64>(buffer);
+        entry.len = size;
+        entry.off = offset;
+        entry.user_data = userData;
+
+        // the entry must be written before the kernel sees the new tail
+        m_submissionArray[index] = index;
+        __atomic_store_n(m_submissionTail, tail + 1, __ATOMIC_RELEASE);
+        ++m_pending;
+    }
+
+    // submit the pushed requests, and wait until at least waitCount
+    // completions are available
+    bool submit(unsigned int waitCount)
+    {
+        while (m_pending > 0 || waitCount > 0)
+        {
+            int result = static_cast<int>(syscall(__NR_io_uring_enter, m_fd, m_pending, waitCount,
+                                                  waitCount > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0));
+            if (result < 0)
+            {
+                // interrupted, or the kernel lacks resources for now
+                if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                    continue;
+                return false;
+            }
+
+            m_pending -= static_cast<unsigned int>(result);
+            waitCount = 0;
+        }
+
+        return true;
+    }
+
+    bool popCompletion(sf::Uint64& userData, int& result)
+    {
+        unsigned int head = *m_completionHead;
+        if (head == __atomic_load_n(m_completionTail, __ATOMIC_ACQUIRE))
+            return false;
+
+        const io_uring_cqe& completion = m_completions[head & m_completionMask];
+        userData = completion.user_data;
+        result = completion.res;
+
+        // the slot can be reused by the kernel once the head has moved
+        __atomic_store_n(m_completionHead, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+
+private:
+
+    void* map(std::size_t size, sf::Uint64 offset)
+    {
+        void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_fd, offset);
+        return mapping != MAP_FAILED ? mapping : NULL;
+    }
+
+    int m_fd;
+    io_uring_params m_parameters;
+    std::size_t m_ringSize;
+    void* m_ring;
+    std::size_t m_completionRingSize;
+    void* m_completionRing;           // NULL when it is part of m_ring
+    io_uring_sqe* m_entries;
+    unsigned int* m_submissionTail;
+    unsigned int m_submissionMask;
+    unsigned int* m_submissionArray;
+    unsigned int* m_completionHead;
+    unsigned int* m_completionTail;
+    unsigned int m_completionMask;
+    io_uring_cqe* m_completions;
+    unsigned int m_pending;           // pushed but not submitted yet
+};
+
+/* The batch loader
+
+Files are opened one after the other, just before their first read is pushed.
+Big files are read in several chunks of 1 MB, which can all be in flight at
+the same time, so a single big file also keeps the device busy.
+
+A file keeps its buffer until the callback has taken it. Decoding is usually
+slower than reading, so without a limit the loader would read the whole
+manifest ahead of the callback, and keep all of it in memory. The loader stops
+opening new files while the files read but not handed to the callback yet
+take more than queueDepth MB (64 MB by default); it goes on when the callback
+catches up. One file is always allowed, however big.
+
+Each request in flight has a slot, which remembers which part of which file it
+reads; its index is the user data of the request, which the completion gives
+back. A read can complete with fewer bytes than requested: the rest is then
+requested again with the same slot.
+
+The callback is called from the thread which called load, one file at a time,
+while the other reads go on. It receives the content of the file in a vector,
+which it may swap with its own to keep it without a copy. Files that can't be
+read are returned by load.
+
+If the ring itself fails, which shouldn't happen, the loader waits for the
+reads already given to the kernel (they write to our buffers), and loads the
+remaining files with the fallback.*/
+class BatchLoader : sf::NonCopyable
+{
+public:
+
+    typedef std::function<void(const std::string& path, std::vector<char>& content)> Callback;
+
+    // queueDepth is the maximum number of reads in flight; useIoUring = false
+    // forces the fallback, to compare both
+    explicit BatchLoader(unsigned int queueDepth = 64, bool useIoUring = true) :
+    m_queueDepth(std::max(queueDepth, 1u)),
+    m_chunkSize(1024 * 1024),
+    m_hasRing(useIoUring && m_ring.create(m_queueDepth))
+    {
+    }
+
+    bool usesIoUring() const
+    {
+        return m_hasRing;
+    }
+
+    std::vector<std::string> load(const std::vector<std::string>& paths, const Callback& callback)
+    {
+        std::vector<std::string> failed;
+        if (m_hasRing)
+            loadWithRing(paths, callback, failed);
+        else
+            loadWithThreads(paths, callback, failed);
+
+        return failed;
+    }
+
+private:
+
+    struct File
+    {
+        File() :
+        fd(-1),
+        submitted(0),
+        readsInFlight(0),
+        failed(false),
+        done(false)
+        {
+        }
+
+        std::string path;
+        int fd;
+        std::vector<char> content;
+        sf::Uint64 submitted;       // bytes for which a read was pushed
+        unsigned int readsInFlight;
+        bool failed;
+        bool done;                  // handed to the callback (or failed)
+    };
+
+    struct Slot
+    {
+        std::size_t file;
+        sf::Uint64 offset;
+        unsigned int size;
+    };
+
+    // open a file and allocate its buffer; false if it can't be read
+    static bool openFile(File& file)
+    {
+        file.fd = ::open(file.path.c_str(), O_RDONLY);
+        if (file.fd < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(file.fd, &status) != 0 || !S_ISREG(status.st_mode))
+            return false;
+
+        file.content.resize(static_cast<std::size_t>(status.st_size));
+        return true;
+    }
+
+    static void closeFile(File& file)
+    {
+        if (file.fd >= 0)
+            ::close(file.fd);
+        file.fd = -1;
+    }
+
+    void loadWithRing(const std::vector<std::string>& paths, const Callback& callback, std::vector<std::string>& failed)
+    {
+        std::vector<File> files(paths.size());
+        std::vector<Slot> slots(m_ring.getCapacity());
+        std::vector<std::size_t> freeSlots;
+        for (std::size_t i = 0; i < slots.size(); ++i)
+            freeSlots.push_back(i);
+
+        std::size_t next = 0;     // the file being submitted
+        std::size_t opened = 0;
+        std::deque<std::size_t> complete;
+        sf::Uint64 buffered = 0;  // bytes of the files opened but not handed to the callback
+        sf::Uint64 limit = m_queueDepth * m_chunkSize;
+        bool error = false;
+
+        while (true)
+        {
+            // fill the free slots with the next chunks to read
+            while (!freeSlots.empty() && next < files.size())
+            {
+                File& file = files[next];
+                if (opened == next)
+                {
+                    // enough data is waiting for the callback
+                    if (buffered >= limit)
+                        break;
+
+                    file.path = paths[next];
+                    file.failed = !openFile(file);
+                    buffered += file.content.size();
+                    ++opened;
+                }
+
+                if (file.failed || file.submitted == file.content.size())
+                {
+                    // nothing more to read in this file: it is complete when
+                    // its last read is
+                    if (file.readsInFlight == 0)
+                        complete.push_back(next);
+                    ++next;
+                    continue;
+                }
+
+                Slot& slot = slots[freeSlots.back()];
+                slot.file = next;
+                slot.offset = file.submitted;
+                slot.size = static_cast<unsigned int>(std::min<sf::Uint64>(m_chunkSize, file.content.size() - file.submitted));
+
+                m_ring.pushRead(file.fd, &file.content[slot.offset], slot.size, slot.offset, freeSlots.back());
+                freeSlots.pop_back();
+                file.submitted += slot.size;
+                ++file.readsInFlight;
+            }
+
+            bool inFlight = freeSlots.size() < slots.size();
+            if (!inFlight && complete.empty())
+                break;
+
+            // submit; when there's nothing to hand to the callback, wait for
+            // a read to complete
+            if (!m_ring.submit(complete.empty() ? 1 : 0))
+            {
+                error = true;
+                break;
+            }
+
+            sf::Uint64 userData;
+            int result;
+            while (m_ring.popCompletion(userData, result))
+            {
+                Slot& slot = slots[static_cast<std::size_t>(userData)];
+                File& file = files[slot.file];
+
+                if (result > 0 && static_cast<unsigned int>(result) < slot.size && !file.failed)
+                {
+                    // short read: request the rest
+                    slot.offset += result;
+                    slot.size -= result;
+                    m_ring.pushRead(file.fd, &file.content[slot.offset], slot.size, slot.offset, userData);
+                    continue;
+                }
+
+                if (result <= 0)
+                    file.failed = true;
+
+                // the file is complete if it isn't being submitted anymore
+                freeSlots.push_back(static_cast<std::size_t>(userData));
+                if (--file.readsInFlight == 0 && slot.file < next)
+                    complete.push_back(slot.file);
+            }
+
+            // hand one file to the callback; the next iteration gives new
+            // requests to the kernel before the next one
+            if (!complete.empty())
+            {
+                File& file = files[complete.front()];
+                complete.pop_front();
+
+                closeFile(file);
+                buffered -= file.content.size();
+                if (file.failed)
+                    failed.push_back(file.path);
+                else
+                    callback(file.path, file.content);
+
+                std::vector<char>().swap(file.content);
+                file.done = true;
+            }
+        }
+
+        if (error)
+        {
+            // the kernel may still be writing to our buffers: don't let them
+            // go before the submitted reads are finished
+            unsigned int submitted = static_cast<unsigned int>(slots.size() - freeSlots.size()) - m_ring.getPendingCount();
+            while (submitted > 0)
+            {
+                sf::Uint64 userData;
+                int result;
+                if (m_ring.popCompletion(userData, result))
+                    --submitted;
+                else
+                    sf::sleep(sf::milliseconds(1));
+            }
+
+            std::vector<std::string> remaining;
+            for (std::size_t i = 0; i < files.size(); ++i)
+            {
+                closeFile(files[i]);
+                if (!files[i].done)
+                    remaining.push_back(paths[i]);
+            }
+
+            m_hasRing = false;
+            loadWithThreads(remaining, callback, failed);
+        }
+    }
+
+    // the fallback: queueDepth threads (at most) read whole files with
+    // blocking reads, and the calling thread runs the callback; the same
+    // limit applies to the files waiting for the callback
+    void loadWithThreads(const std::vector<std::string>& paths, const Callback& callback, std::vector<std::string>& failed)
+    {
+        std::vector<File> files(paths.size());
+        std::size_t next = 0;
+        std::deque<std::size_t> complete;
+        sf::Uint64 buffered = 0;
+        sf::Uint64 limit = m_queueDepth * m_chunkSize;
+        std::mutex mutex;
+        std::condition_variable completed; // a file was read
+        std::condition_variable consumed;  // a file was handed to the callback
+
+        std::vector<std::thread> workers;
+        std::size_t count = std::min<std::size_t>(std::min(m_queueDepth, 16u), paths.size());
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            workers.push_back(std::thread([&]()
+            {
+                while (true)
+                {
+                    std::size_t index;
+                    {
+                        std::unique_lock<std::mutex> lock(mutex);
+                        while (buffered >= limit && next < files.size())
+                            consumed.wait(lock);
+
+                        if (next == files.size())
+                            return;
+                        index = next++;
+                    }
+
+                    File& file = files[index];
+                    file.path = paths[index];
+                    file.failed = !openFile(file);
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        buffered += file.content.size();
+                    }
+
+                    for (sf::Uint64 offset = 0; !file.failed && offset < file.content.size(); )
+                    {
+                        ssize_t result = pread(file.fd, &file.content[offset], file.content.size() - offset, offset);
+                        if (result > 0)
+                            offset += result;
+                        else if (result == 0 || errno != EINTR)
+                            file.failed = true;
+                    }
+                    closeFile(file);
+
+                    std::lock_guard<std::mutex> lock(mutex);
+                    complete.push_back(index);
+                    completed.notify_one();
+                }
+            }));
+        }
+
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            std::size_t index;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                while (complete.empty())
+                    completed.wait(lock);
+
+                index = complete.front();
+                complete.pop_front();
+                buffered -= files[index].content.size();
+            }
+            consumed.notify_all();
+
+            File& file = files[index];
+            if (file.failed)
+                failed.push_back(file.path);
+            else
+                callback(file.path, file.content);
+
+            std::vector<char>().swap(file.content);
+        }
+
+        for (std::size_t i = 0; i < workers.size(); ++i)
+            workers[i].join();
+    }
+
+    unsigned int m_queueDepth;
+    sf::Uint64 m_chunkSize;
+    IoUring m_ring;
+    bool m_hasRing;
+};
+
+//Files are handed to the callback in the order in which they complete, not in
+//the order of the manifest. The callback gets the path, so it knows which
+//asset it is decoding.
+
+//Decoding is usually slower than reading from a fast drive. To go further,
+//the callback can give the content to the worker threads of the background
+//texture loading tutorial (with loadFromMemory instead of loadFromFile), so
+//that several files are decoded at the same time.
+
+//The reads go through the system's file cache. For data that is read once,
+//opening the files with O_DIRECT bypasses the cache and saves a copy, but
+//then the buffers, offsets and sizes must all be aligned on the block size of
+//the device (usually 4 KB).
+
+/* A demo
+
+    sfml-app sequential manifest.txt
+    sfml-app batch manifest.txt
+    sfml-app threads manifest.txt
+
+The manifest lists the files to load, one per line. The demo loads them one
+after the other with sf::FileInputStream (sequential), or with the batch
+loader, using io_uring when possible (batch) or the fallback threads
+(threads). The images among them are decoded with sf::Image::loadFromMemory.
+
+Each run uses a single mode: after a first pass, the files are in the file
+cache, and a second pass in the same run would read them from memory. To
+compare reads from the device, drop the cache before each run (on Linux:
+echo 3 > /proc/sys/vm/drop_caches, as root).*/
+std::vector<std::string> readManifest(const std::string& filename)
+{
+    std::vector<std::string> paths;
+    std::ifstream manifest(filename.c_str());
+
+    std::string line;
+    while (std::getline(manifest, line))
+    {
+        if (!line.empty() && line[0] != '#')
+            paths.push_back(line);
+    }
+
+    return paths;
+}
+
+bool isImage(const std::string& path)
+{
+    const char* extensions[] = {".png", ".jpg", ".bmp", ".tga"};
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        if (path.size() >= 4 && path.compare(path.size() - 4, 4, extensions[i]) == 0)
+            return true;
+    }
+
+    return false;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string mode = argc == 3 ? argv[1] : "";
+    if (mode != "sequential" && mode != "batch" && mode != "threads")
+    {
+        std::cout << "usage: sfml-app sequential|batch|threads manifest.txt" << std::endl;
+        return 1;
+    }
+
+    std::vector<std::string> paths = readManifest(argv[2]);
+    std::vector<std::string> failed;
+    sf::Uint64 total = 0;
+    std::size_t images = 0;
+
+    sf::Clock clock;
+    if (mode == "sequential")
+    {
+        // the usual way
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            sf::FileInputStream stream;
+            if (!stream.open(paths[i]))
+            {
+                failed.push_back(paths[i]);
+                continue;
+            }
+
+            std::vector<char> content(static_cast<std::size_t>(stream.getSize()));
+            if (!content.empty() && stream.read(&content[0], content.size()) != static_cast<sf::Int64>(content.size()))
+            {
+                failed.push_back(paths[i]);
+                continue;
+            }
+
+            total += content.size();
+
+            sf::Image image;
+            if (isImage(paths[i]) && !content.empty() && image.loadFromMemory(&content[0], content.size()))
+                ++images;
+        }
+
+        std::cout << "sf::FileInputStream: ";
+    }
+    else
+    {
+        BatchLoader loader(64, mode == "batch");
+        failed = loader.load(paths, [&](const std::string& path, std::vector<char>& content)
+        {
+            total += content.size();
+
+            sf::Image image;
+            if (isImage(path) && !content.empty() && image.loadFromMemory(&content[0], content.size()))
+                ++images;
+        });
+
+        std::cout << (loader.usesIoUring() ? "io_uring: " : "threads: ");
+    }
+    sf::Time time = clock.getElapsedTime();
+
+    std::cout << time.asMilliseconds() << " ms, " << paths.size() << " files, "
+              << total / (1024 * 1024) << " MB, " << images << " images" << std::endl;
+
+    for (std::size_t i = 0; i < failed.size(); ++i)
+        std::cout << "failed to load " << failed[i] << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,375 @@
+/* Reading compressed data with random access
+
+compile with:  g++ -c Compressed_Streams.cpp
+and then link to get the executable with:
+
+    g++ Compressed_Streams.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system -lz
+*/
+
+/* Introduction
+
+The user data streams tutorial gives compressed archives as the first reason to
+write a custom stream. The difficulty is that the usual compressed formats
+(a .gz file, a zlib stream) can only be decompressed from the beginning: to
+read the byte at position 10 MB, everything before it must be decompressed
+first. That's fine for an image, which is read once from start to end, but
+not for sf::Font, which reads the font file here and there every time it needs
+a new glyph, or for sf::Music, which seeks when the music loops or when
+setPlayingOffset is called.
+
+So instead of compressing the file as a whole, we cut it into blocks of fixed
+size (64 KB), and compress each block independently. An index at the end of
+the file gives where each compressed block starts. To read anywhere in the
+file, the stream finds the blocks that contain the requested bytes, and only
+decompresses those. The last few decompressed blocks are kept, because reads
+are usually close to the previous ones.
+
+Compression is done with zlib, which is available on every platform.*/
+
+#include <SFML/Graphics.hpp>
+#include <zlib.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+/* The file format
+
+    Header
+    compressed blocks, one after the other
+    Uint64[blockCount + 1]   the index: the offset of each block in the file,
+                             plus the end of the last one
+
+A block is stored as it is (not compressed) when compressing it doesn't make
+it smaller; this is the case when its compressed size is its uncompressed
+size. All the blocks have the same uncompressed size, except the last one.*/
+namespace blocks
+{
+    struct Header
+    {
+        char magic[4];
+        sf::Uint32 version;
+        sf::Uint32 blockSize;
+        sf::Uint32 blockCount;
+        sf::Uint64 size;         // uncompressed
+        sf::Uint64 indexOffset;
+    };
+}
+
+/* The compressed stream
+
+The stream reads from another stream, which can be a sf::FileInputStream, an
+entry of a pack file, or anything else: compression is added on top of the
+source, not built into it. Like any stream, the source must stay alive as long
+as the compressed stream is used.*/
+class CompressedInputStream : public sf::InputStream
+{
+public:
+
+    // cacheSize is the number of decompressed blocks that are kept
+    explicit CompressedInputStream(std::size_t cacheSize = 4) :
+    m_source(NULL),
+    m_offset(0),
+    m_cache(std::max<std::size_t>(cacheSize, 1)),
+    m_clock(0),
+    m_decompressedCount(0)
+    {
+        std::memset(&m_header, 0, sizeof(m_header));
+    }
+
+    bool open(sf::InputStream& source)
+    {
+        m_source = NULL;
+
+        if (source.seek(0) != 0 || source.read(&m_header, sizeof(m_header)) != sizeof(m_header))
+            return false;
+
+        if (std::memcmp(m_header.magic, "SFZB", 4) != 0 || m_header.version != 1 || m_header.blockSize == 0 ||
+            m_header.blockCount != (m_header.size + m_header.blockSize - 1) / m_header.blockSize)
+            return false;
+
+        // the index ends the file: check that its size matches the header
+        // before allocating it, a corrupt header could ask for gigabytes
+        sf::Uint64 indexSize = (static_cast<sf::Uint64>(m_header.blockCount) + 1) * sizeof(sf::Uint64);
+        sf::Int64 fileSize = source.getSize();
+        if (fileSize < 0 || m_header.indexOffset < sizeof(m_header) ||
+            m_header.indexOffset + indexSize != static_cast<sf::Uint64>(fileSize))
+            return false;
+
+        m_index.resize(static_cast<std::size_t>(m_header.blockCount) + 1);
+        if (source.seek(m_header.indexOffset) != static_cast<sf::Int64>(m_header.indexOffset) ||
+            source.read(&m_index[0], static_cast<sf::Int64>(indexSize)) != static_cast<sf::Int64>(indexSize))
+            return false;
+
+        // the blocks follow the header, and the index follows the last block
+        if (m_index[0] != sizeof(m_header) || m_index[m_header.blockCount] != m_header.indexOffset)
+            return false;
+
+        for (std::size_t i = 0; i < m_header.blockCount; ++i)
+        {
+            if (m_index[i + 1] <= m_index[i] || m_index[i + 1] - m_index[i] > compressBound(m_header.blockSize))
+                return false;
+        }
+
+        for (std::size_t i = 0; i < m_cache.size(); ++i)
+        {
+            m_cache[i].block = -1;
+            m_cache[i].lastUse = 0;
+        }
+
+        m_source = &source;
+        m_offset = 0;
+        return true;
+    }
+
+    virtual sf::Int64 read(void* data, sf::Int64 size)
+    {
+        if (!m_source)
+            return -1;
+
+        char* output = static_cast<char*>(data);
+        sf::Int64 total = static_cast<sf::Int64>(m_header.size);
+        sf::Int64 count = std::max<sf::Int64>(0, std::min(size, total - m_offset));
+        sf::Int64 done = 0;
+
+        // copy from each block that contains a part of the requested range
+        while (done < count)
+        {
+            sf::Int64 block = m_offset / m_header.blockSize;
+            sf::Int64 inBlock = m_offset % m_header.blockSize;
+
+            const std::vector<char>* content = getBlock(block);
+            if (!content)
+                return done > 0 ? done : -1;
+
+            sf::Int64 available = std::min<sf::Int64>(static_cast<sf::Int64>(content->size()) - inBlock, count - done);
+            std::memcpy(output + done, &(*content)[static_cast<std::size_t>(inBlock)], static_cast<std::size_t>(available));
+
+            done += available;
+            m_offset += available;
+        }
+
+        return done;
+    }
+
+    // seeking only moves the position: nothing is decompressed until the
+    // next read
+    virtual sf::Int64 seek(sf::Int64 position)
+    {
+        if (!m_source)
+            return -1;
+
+        m_offset = std::max<sf::Int64>(0, std::min<sf::Int64>(position, m_header.size));
+        return m_offset;
+    }
+
+    virtual sf::Int64 tell()
+    {
+        return m_source ? m_offset : -1;
+    }
+
+    virtual sf::Int64 getSize()
+    {
+        return m_source ? static_cast<sf::Int64>(m_header.size) : -1;
+    }
+
+    // the number of blocks that had to be decompressed so far
+    std::size_t getDecompressedCount() const
+    {
+        return m_decompressedCount;
+    }
+
+private:
+
+    struct CachedBlock
+    {
+        sf::Int64 block;
+        sf::Uint64 lastUse;
+        std::vector<char> content;
+    };
+
+    // the decompressed content of a block, from the cache or from the source
+    const std::vector<char>* getBlock(sf::Int64 block)
+    {
+        ++m_clock;
+
+        // the cache is small, a linear search is the fastest
+        CachedBlock* oldest = &m_cache[0];
+        for (std::size_t i = 0; i < m_cache.size(); ++i)
+        {
+            if (m_cache[i].block == block)
+            {
+                m_cache[i].lastUse = m_clock;
+                return &m_cache[i].content;
+            }
+
+            if (m_cache[i].lastUse < oldest->lastUse)
+                oldest = &m_cache[i];
+        }
+
+        // replace the least recently used block
+        sf::Uint64 start = m_index[static_cast<std::size_t>(block)];
+        sf::Uint64 compressedSize = m_index[static_cast<std::size_t>(block) + 1] - start;
+        sf::Uint64 size = std::min<sf::Uint64>(m_header.blockSize, m_header.size - block * m_header.blockSize);
+
+        m_compressed.resize(static_cast<std::size_t>(compressedSize));
+        if (m_source->seek(start) != static_cast<sf::Int64>(start) ||
+            m_source->read(&m_compressed[0], compressedSize) != static_cast<sf::Int64>(compressedSize))
+            return NULL;
+
+        oldest->block = -1;
+        oldest->content.resize(static_cast<std::size_t>(size));
+
+        if (compressedSize == size)
+        {
+            // stored as it is
+            std::memcpy(&oldest->content[0], &m_compressed[0], static_cast<std::size_t>(size));
+        }
+        else
+        {
+            uLongf length = static_cast<uLongf>(size);
+            if (uncompress(reinterpret_cast<Bytef*>(&oldest->content[0]), &length,
+                           reinterpret_cast<const Bytef*>(&m_compressed[0]), static_cast<uLong>(compressedSize)) != Z_OK ||
+                length != size)
+                return NULL;
+        }
+
+        ++m_decompressedCount;
+        oldest->block = block;
+        oldest->lastUse = m_clock;
+        return &oldest->content;
+    }
+
+    sf::InputStream* m_source;
+    blocks::Header m_header;
+    std::vector<sf::Uint64> m_index;
+    sf::Int64 m_offset;
+    std::vector<CachedBlock> m_cache;
+    std::vector<char> m_compressed;   // kept to avoid allocations
+    sf::Uint64 m_clock;
+    std::size_t m_decompressedCount;
+};
+
+/* The compressor
+
+It reads the input file block by block, writes each compressed block, and
+finally the index. The header is written twice: first as a placeholder, then,
+once the index position is known, for real.*/
+bool compressFile(const std::string& input, const std::string& output,
+                  sf::Uint32 blockSize = 64 * 1024, int level = Z_BEST_COMPRESSION)
+{
+    std::FILE* source = std::fopen(input.c_str(), "rb");
+    if (!source)
+        return false;
+
+    std::FILE* destination = std::fopen(output.c_str(), "wb");
+    if (!destination)
+    {
+        std::fclose(source);
+        return false;
+    }
+
+    blocks::Header header;
+    std::memcpy(header.magic, "SFZB", 4);
+    header.version = 1;
+    header.blockSize = blockSize;
+    header.blockCount = 0;
+    header.size = 0;
+    header.indexOffset = 0;
+    std::fwrite(&header, sizeof(header), 1, destination);
+
+    std::vector<char> block(blockSize);
+    std::vector<char> compressed(compressBound(blockSize));
+    std::vector<sf::Uint64> index(1, sizeof(header));
+    std::size_t count;
+
+    while ((count = std::fread(&block[0], 1, block.size(), source)) > 0)
+    {
+        uLongf length = static_cast<uLongf>(compressed.size());
+        bool smaller = compress2(reinterpret_cast<Bytef*>(&compressed[0]), &length,
+                                 reinterpret_cast<const Bytef*>(&block[0]), static_cast<uLong>(count), level) == Z_OK &&
+                       length < count;
+
+        if (smaller)
+            std::fwrite(&compressed[0], 1, length, destination);
+        else
+            std::fwrite(&block[0], 1, count, destination);
+
+        index.push_back(index.back() + (smaller ? length : count));
+        header.size += count;
+        ++header.blockCount;
+    }
+
+    header.indexOffset = index.back();
+    std::fwrite(&index[0], sizeof(sf::Uint64), index.size(), destination);
+
+    std::fseek(destination, 0, SEEK_SET);
+    std::fwrite(&header, sizeof(header), 1, destination);
+
+    bool success = !std::ferror(source) && !std::ferror(destination);
+    std::fclose(source);
+    success = (std::fclose(destination) == 0) && success;
+
+    if (success)
+        std::cout << input << ": " << header.size << " -> " << header.indexOffset + index.size() * sizeof(sf::Uint64)
+                  << " bytes" << std::endl;
+
+    return success;
+}
+
+//The block size is a trade-off: small blocks make random reads cheaper (less
+//data to decompress for a few bytes) but compress less well, since each block
+//starts from scratch. 64 KB is a good default; for music, which is read
+//sequentially, 256 KB compresses a little better.
+
+//Already compressed formats (PNG, JPEG, OGG, FLAC) barely get smaller: the
+//compressor then stores their blocks as they are, and reading them costs a
+//copy. Compression pays off for uncompressed data: WAV sounds, fonts, level
+//data, text, shaders.
+
+/* A demo
+
+    sfml-app compress arial.ttf arial.ttf.z     compresses a file
+    sfml-app                                    runs the demo
+
+The demo loads a font from its compressed file. sf::Font keeps reading from the
+stream as the text needs new glyphs, so the stream is kept alive as long as
+the font, and only the blocks that contain the needed glyphs are
+decompressed. */
+int main(int argc, char* argv[])
+{
+    if (argc == 4 && std::string(argv[1]) == "compress")
+        return compressFile(argv[2], argv[3]) ? 0 : 1;
+
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Compressed streams");
+
+    sf::FileInputStream file;
+    CompressedInputStream stream;
+    if (!file.open("arial.ttf.z") || !stream.open(file))
+        return -1;
+
+    sf::Font font;
+    if (!font.loadFromStream(stream))
+        return -1;
+
+    sf::Text text("Loaded from a compressed stream", font, 30);
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        window.clear();
+        window.draw(text);
+        window.display();
+    }
+
+    std::cout << stream.getDecompressedCount() << " blocks decompressed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,477 @@
+/* Storing assets by content
+
+compile with:  g++ -std=c++11 -c Content_Addressed_Assets.cpp
+and then link to get the executable with:
+
+    g++ Content_Addressed_Assets.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+Games often contain the same file several times under different names: the
+grass texture copied in the folder of every level, the click sound of every
+menu, a placeholder image that was never replaced. Each copy is downloaded,
+stored on disk, and, since the program only knows the files by their path,
+loaded and decoded again into its own texture or sound buffer.
+
+A content-addressed store names each file by a hash of its content instead of
+its path. Identical files have the same hash, so they are stored once. The
+paths only remain in an index, which maps each path to the hash of its
+content: several paths can map to the same hash, they are aliases of the same
+object.
+
+The same key works in memory: resources are cached by hash, not by path, so
+"level1/grass.png" and "level2/grass.png" give the same sf::Texture, decoded
+and uploaded once.
+
+A store is a directory:
+
+    index.txt                            one line per path: hash, size, path
+    objects/3f/3fa1c4e2b08d6e71          one file per distinct content
+
+As with pack files, the objects are read through sf::InputStream, so the
+resources don't need to know where their data comes from.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+/* Hashing
+
+The hash is the 64-bit FNV-1a, the same one as in the pack files tutorial,
+written in 16 hexadecimal digits. With 64 bits, the probability of two
+different files having the same hash is negligible, even with millions of
+files; and the builder below compares the bytes of files with the same hash
+anyway, so that a collision would be detected rather than merge two different
+files.*/
+namespace store
+{
+    sf::Uint64 hash(const char* data, std::size_t size)
+    {
+        sf::Uint64 result = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < size; ++i)
+        {
+            result ^= static_cast<unsigned char>(data[i]);
+            result *= 1099511628211ULL;
+        }
+
+        return result;
+    }
+
+    std::string toHex(sf::Uint64 hash)
+    {
+        char text[17];
+        std::snprintf(text, sizeof(text), "%016llx", static_cast<unsigned long long>(hash));
+        return text;
+    }
+
+    // the objects are spread over 256 subdirectories, by the first two digits
+    // of their hash, to avoid directories with too many files
+    std::string getObjectPath(const std::string& directory, sf::Uint64 hash)
+    {
+        std::string name = toHex(hash);
+        return directory + "/objects/" + name.substr(0, 2) + "/" + name;
+    }
+
+    bool readFile(const std::string& path, std::vector<char>& content)
+    {
+        sf::FileInputStream stream;
+        if (!stream.open(path))
+            return false;
+
+        content.resize(static_cast<std::size_t>(stream.getSize()));
+        return content.empty() || stream.read(&content[0], content.size()) == stream.getSize();
+    }
+}
+
+/* The store
+
+Opening a store only reads the index. openStream then resolves a path to its
+object and opens the object file; different paths which are aliases open the
+same file.*/
+class AssetStore
+{
+public:
+
+    bool open(const std::string& directory)
+    {
+        m_directory = directory;
+        m_objects.clear();
+
+        std::ifstream index((directory + "/index.txt").c_str());
+        if (!index)
+            return false;
+
+        std::string line;
+        while (std::getline(index, line))
+        {
+            // hash and size, then the path, which may contain spaces
+            std::istringstream fields(line);
+            std::string hash;
+            Object object;
+            if (!(fields >> hash >> object.size) || hash.size() != 16 ||
+                hash.find_first_not_of("0123456789abcdef") != std::string::npos)
+                return false;
+
+            object.hash = std::stoull(hash, NULL, 16);
+
+            std::string path;
+            std::getline(fields >> std::ws, path);
+            m_objects[path] = object;
+        }
+
+        return true;
+    }
+
+    bool contains(const std::string& path) const
+    {
+        return m_objects.find(path) != m_objects.end();
+    }
+
+    // the hash of the content of a path: two paths with the same hash have
+    // the same content; false if the path is not in the store
+    bool getHash(const std::string& path, sf::Uint64& hash) const
+    {
+        std::unordered_map<std::string, Object>::const_iterator it = m_objects.find(path);
+        if (it == m_objects.end())
+            return false;
+
+        hash = it->second.hash;
+        return true;
+    }
+
+    bool openStream(const std::string& path, sf::FileInputStream& stream) const
+    {
+        std::unordered_map<std::string, Object>::const_iterator it = m_objects.find(path);
+        if (it == m_objects.end())
+            return false;
+
+        return stream.open(store::getObjectPath(m_directory, it->second.hash)) &&
+               stream.getSize() == static_cast<sf::Int64>(it->second.size);
+    }
+
+    std::size_t getPathCount() const
+    {
+        return m_objects.size();
+    }
+
+    std::size_t getObjectCount() const
+    {
+        std::vector<sf::Uint64> hashes;
+        for (std::unordered_map<std::string, Object>::const_iterator it = m_objects.begin(); it != m_objects.end(); ++it)
+            hashes.push_back(it->second.hash);
+
+        std::sort(hashes.begin(), hashes.end());
+        return static_cast<std::size_t>(std::unique(hashes.begin(), hashes.end()) - hashes.begin());
+    }
+
+private:
+
+    struct Object
+    {
+        sf::Uint64 hash;
+        sf::Uint64 size;
+    };
+
+    std::string m_directory;
+    std::unordered_map<std::string, Object> m_objects;   // by path
+};
+
+/* The resource cache
+
+The cache gives shared pointers to resources, and only keeps weak pointers
+itself: a resource lives as long as someone uses it, then it is destroyed (the
+resource cache tutorial shows how to keep unused resources for a while, under
+a memory budget). The key is the hash, so all the aliases share the same
+resource.
+
+Most resources are done with their stream once loadFromStream returns, so the
+stream is closed right away: otherwise each live texture or sound buffer would
+keep a file descriptor, and a level with a few hundred assets would reach the
+limit of the system (1024 by default on Linux). sf::Font is the exception: it
+keeps reading from its stream after loading, so its stream is stored with it,
+and the shared pointer owns both, but points to the font.*/
+
+// whether a resource keeps reading from its stream after loadFromStream
+template <typename Resource>
+struct KeepsStream
+{
+    static const bool value = false;
+};
+
+template <>
+struct KeepsStream<sf::Font>
+{
+    static const bool value = true;
+};
+
+// a cached resource, with its stream when it needs it
+template <typename Resource, bool KeepStream = KeepsStream<Resource>::value>
+struct AssetEntry
+{
+    bool load(const AssetStore& assets, const std::string& path)
+    {
+        sf::FileInputStream stream;
+        return assets.openStream(path, stream) && resource.loadFromStream(stream);
+    }
+
+    Resource resource;
+};
+
+template <typename Resource>
+struct AssetEntry<Resource, true>
+{
+    bool load(const AssetStore& assets, const std::string& path)
+    {
+        return assets.openStream(path, stream) && resource.loadFromStream(stream);
+    }
+
+    sf::FileInputStream stream;
+    Resource resource;
+};
+
+template <typename Resource>
+class AssetCache
+{
+public:
+
+    explicit AssetCache(const AssetStore& assets) :
+    m_store(assets),
+    m_loadCount(0)
+    {
+    }
+
+    // NULL if the path is not in the store or can't be loaded
+    std::shared_ptr<Resource> get(const std::string& path)
+    {
+        sf::Uint64 hash;
+        if (!m_store.getHash(path, hash))
+            return std::shared_ptr<Resource>();
+
+        std::shared_ptr<Resource> resource = m_resources[hash].lock();
+        if (resource)
+            return resource;
+
+        std::shared_ptr<AssetEntry<Resource> > entry = std::make_shared<AssetEntry<Resource> >();
+        if (!entry->load(m_store, path))
+        {
+            m_resources.erase(hash);
+            return std::shared_ptr<Resource>();
+        }
+
+        ++m_loadCount;
+        resource = std::shared_ptr<Resource>(entry, &entry->resource);
+        m_resources[hash] = resource;
+        return resource;
+    }
+
+    // the number of resources that were really loaded
+    std::size_t getLoadCount() const
+    {
+        return m_loadCount;
+    }
+
+private:
+
+    const AssetStore& m_store;
+    std::unordered_map<sf::Uint64, std::weak_ptr<Resource> > m_resources;
+    std::size_t m_loadCount;
+};
+
+//The weak pointers of destroyed resources stay in the map. They are small, and
+//reused if the same content is needed again; a game which loads a lot of
+//different files over time can remove the expired ones from time to time.
+
+/* Building a store
+
+The builder reads every input file, hashes it, and writes its object unless
+an object with the same hash already exists -- written earlier in the same
+build, or by a previous build into the same directory. In both cases, the
+bytes of the existing object are compared with the file, to detect the
+(very unlikely) collision of two different files.
+
+Files are written under a temporary name, then renamed: a build which is
+interrupted never leaves a truncated object or index behind. The index is
+written last, so a program reading the store never sees an index which refers
+to missing objects.*/
+namespace store
+{
+    void collect(const std::string& path, std::vector<std::string>& files)
+    {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+        {
+            std::cerr << "Cannot find " << path << std::endl;
+            return;
+        }
+
+        if (S_ISDIR(status.st_mode))
+        {
+            DIR* directory = opendir(path.c_str());
+            if (!directory)
+                return;
+
+            while (dirent* entry = readdir(directory))
+            {
+                std::string name = entry->d_name;
+                if (name != "." && name != "..")
+                    collect(path + "/" + name, files);
+            }
+
+            closedir(directory);
+        }
+        else if (S_ISREG(status.st_mode))
+        {
+            files.push_back(path);
+            std::replace(files.back().begin(), files.back().end(), '\\', '/');
+        }
+    }
+
+    bool writeFile(const std::string& path, const std::vector<char>& content)
+    {
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary.c_str(), std::ios::binary);
+            if (!content.empty())
+                file.write(&content[0], content.size());
+            if (!file.flush())
+                return false;
+        }
+
+        return std::rename(temporary.c_str(), path.c_str()) == 0;
+    }
+
+    bool build(const std::string& directory, const std::vector<std::string>& paths)
+    {
+        std::vector<std::string> files;
+        for (std::size_t i = 0; i < paths.size(); ++i)
+            collect(paths[i], files);
+
+        std::sort(files.begin(), files.end());
+        files.erase(std::unique(files.begin(), files.end()), files.end());
+
+        mkdir(directory.c_str(), 0755);
+        mkdir((directory + "/objects").c_str(), 0755);
+
+        std::ostringstream index;
+        std::vector<char> content;
+        std::vector<char> existing;
+        sf::Uint64 totalSize = 0;
+        sf::Uint64 storedSize = 0;
+
+        for (std::size_t i = 0; i < files.size(); ++i)
+        {
+            if (!readFile(files[i], content))
+            {
+                std::cerr << "Cannot read " << files[i] << std::endl;
+                return false;
+            }
+
+            sf::Uint64 contentHash = hash(content.empty() ? NULL : &content[0], content.size());
+            std::string objectPath = getObjectPath(directory, contentHash);
+
+            if (readFile(objectPath, existing))
+            {
+                if (existing != content)
+                {
+                    std::cerr << "The object of " << files[i] << " has a different content (damaged store or hash collision)" << std::endl;
+                    return false;
+                }
+            }
+            else
+            {
+                mkdir(objectPath.substr(0, objectPath.size() - 17).c_str(), 0755);
+                if (!writeFile(objectPath, content))
+                {
+                    std::cerr << "Cannot write " << objectPath << std::endl;
+                    return false;
+                }
+
+                storedSize += content.size();
+            }
+
+            totalSize += content.size();
+            index << toHex(contentHash) << ' ' << content.size() << ' ' << files[i] << '\n';
+        }
+
+        std::string text = index.str();
+        if (!writeFile(directory + "/index.txt", std::vector<char>(text.begin(), text.end())))
+        {
+            std::cerr << "Cannot write " << directory << "/index.txt" << std::endl;
+            return false;
+        }
+
+        std::cout << files.size() << " files, " << totalSize << " bytes; " << storedSize << " new bytes stored" << std::endl;
+        return true;
+    }
+}
+
+//Objects are never modified: a file that changes gets a new hash, so a new
+//object. This is what makes updates cheap. An updater downloads the new index,
+//then only the objects whose hash it doesn't have yet, whatever the paths they
+//are used under. Objects which no index refers to anymore can be deleted at
+//the end of the update.
+
+//The objects can also be packed into a single archive, as in the pack files
+//tutorial, with the hash as the key of the table of contents instead of the
+//path: the index then maps paths to hashes, and the archive hashes to data.
+
+/* A demo
+
+    sfml-app build store assets         builds (or updates) a store from files
+    sfml-app                            runs the demo
+
+The demo loads the same texture under two paths: they are aliases, so it is
+loaded only once, and both sprites use the same sf::Texture.*/
+int main(int argc, char* argv[])
+{
+    if (argc >= 3 && std::string(argv[1]) == "build")
+        return store::build(argv[2], std::vector<std::string>(argv + 3, argv + argc)) ? 0 : 1;
+
+    AssetStore assets;
+    if (!assets.open("store"))
+        return -1;
+
+    std::cout << assets.getPathCount() << " paths, " << assets.getObjectCount() << " objects" << std::endl;
+
+    AssetCache<sf::Texture> textures(assets);
+    std::shared_ptr<sf::Texture> first = textures.get("assets/level1/grass.png");
+    std::shared_ptr<sf::Texture> second = textures.get("assets/level2/grass.png");
+    if (!first || !second)
+        return -1;
+
+    std::cout << textures.getLoadCount() << " texture(s) loaded" << std::endl;
+
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Content-addressed assets");
+
+    sf::Sprite left(*first);
+    sf::Sprite right(*second);
+    right.setPosition(400, 0);
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        window.clear();
+        window.draw(left);
+        window.draw(right);
+        window.display();
+    }
+
+    return 0;
+}
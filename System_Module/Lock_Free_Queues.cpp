@@ -0,0 +1,473 @@
+/* Passing messages between threads without locks
+
+compile with:  g++ -std=c++11 -O2 -c Lock_Free_Queues.cpp
+and then link to get the executable with:
+
+    g++ Lock_Free_Queues.o -o sfml-app -lsfml-system -pthread
+*/
+
+/* Introduction
+
+The threads tutorial protects shared data with sf::Mutex. To pass messages
+from a thread to another (loaded resources from a loading thread, events from
+an audio thread), the usual pattern is a std::vector protected by a mutex: the
+sender locks, pushes, unlocks; the receiver locks, takes everything, unlocks.
+
+It works, but when the threads use the queue at the same time, one of them
+finds the mutex locked, and the system puts it to sleep until the mutex is
+free. Waking it up takes a few microseconds, sometimes much more if the
+system has something else to run. The average is fine; the worst cases are
+not, and for an audio thread, the worst case is what makes the sound crackle.
+
+The queues below never put a thread to sleep. They are ring buffers of fixed
+size, whose positions are atomic variables: a thread pushes or pops by
+reading and updating these positions, and no thread ever waits for another
+one to release anything.
+
+- SpscQueue has a single producer thread and a single consumer thread: each
+  position is written by one thread only, which makes it very simple and very
+  fast
+- MpscQueue accepts any number of producer threads, still with a single
+  consumer; this is the main thread receiving from many workers
+
+Both can push and pop many elements at once: the cost of synchronizing is then
+paid once per batch instead of once per element.
+
+When a queue is full, push doesn't wait: it returns how many elements it
+could push, and the producer decides what to do (retry later, drop, or keep
+the messages in a local list).*/
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+/* False sharing
+
+Processors don't move single variables between their caches, but whole cache
+lines of 64 bytes. If the position written by the producer and the position
+written by the consumer are in the same line, each write by one thread
+invalidates the copy of the other thread, even though they don't use the same
+variable. The positions are therefore aligned on their own cache line with
+alignas, which also pads the end of the queue to a whole line.
+
+(Before C++17, new doesn't respect alignments larger than the one of
+std::max_align_t: declare the queues as members or static variables, or
+allocate them with an aligned allocation function.)*/
+const std::size_t CacheLineSize = 64;
+
+// round up to a power of two, so that positions can be wrapped with a mask
+inline std::size_t roundUpToPowerOfTwo(std::size_t value)
+{
+    std::size_t result = 1;
+    while (result < value)
+        result *= 2;
+    return result;
+}
+
+/* The single producer, single consumer queue
+
+The producer writes the elements, then moves m_tail with a release store: the
+consumer, which reads m_tail with an acquire load, is guaranteed to see the
+elements. In the other direction, the consumer moves m_head once it has read
+the elements, which tells the producer that their slots are free again.
+
+The positions only grow; they are wrapped with the mask when accessing the
+buffer. Each side also keeps a copy of the other side's position, and only
+reads the real one (whose cache line is owned by the other thread) when the
+copy says that the queue is full or empty.*/
+template <typename T>
+class SpscQueue : sf::NonCopyable
+{
+public:
+
+    explicit SpscQueue(std::size_t capacity) :
+    m_buffer(roundUpToPowerOfTwo(capacity)),
+    m_mask(m_buffer.size() - 1),
+    m_head(0),
+    m_cachedTail(0),
+    m_tail(0),
+    m_cachedHead(0)
+    {
+    }
+
+    // producer only; returns the number of elements pushed
+    std::size_t push(const T* elements, std::size_t count)
+    {
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (m_buffer.size() - (tail - m_cachedHead) < count)
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+
+        count = std::min(count, m_buffer.size() - (tail - m_cachedHead));
+        for (std::size_t i = 0; i < count; ++i)
+            m_buffer[(tail + i) & m_mask] = elements[i];
+
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    bool push(const T& element)
+    {
+        return push(&element, 1) == 1;
+    }
+
+    // consumer only; returns the number of elements popped
+    std::size_t pop(T* elements, std::size_t count)
+    {
+        std::size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_cachedTail - head < count)
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+
+        count = std::min(count, m_cachedTail - head);
+        for (std::size_t i = 0; i < count; ++i)
+            elements[i] = m_buffer[(head + i) & m_mask];
+
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    bool pop(T& element)
+    {
+        return pop(&element, 1) == 1;
+    }
+
+    std::size_t getCapacity() const
+    {
+        return m_buffer.size();
+    }
+
+private:
+
+    std::vector<T> m_buffer;
+    std::size_t m_mask;
+
+    // written by the consumer
+    alignas(CacheLineSize) std::atomic<std::size_t> m_head;
+    std::size_t m_cachedTail;
+
+    // written by the producer
+    alignas(CacheLineSize) std::atomic<std::size_t> m_tail;
+    std::size_t m_cachedHead;
+};
+
+/* The multiple producers, single consumer queue
+
+With several producers, writing the elements and then moving the tail doesn't
+work anymore: two producers could write the same slots. Instead, a producer
+first reserves its slots, by moving m_tail with a compare-and-swap (only one
+producer can succeed for a given value of the tail; the others retry with the
+new one), then writes its elements.
+
+The consumer must not read a slot which is reserved but not written yet. So
+each slot has a sequence number, which tells its state:
+
+- sequence == position: the slot is free for the element at this position
+- sequence == position + 1: the element is written, it can be read
+- after reading, the consumer sets it to position + capacity: the slot is free
+  for the element one turn later
+
+Since the consumer frees the slots in order, if the last slot of a batch is
+free, all the slots before it are free too: a producer only checks the last
+one before reserving a whole batch.*/
+template <typename T>
+class MpscQueue : sf::NonCopyable
+{
+public:
+
+    explicit MpscQueue(std::size_t capacity) :
+    m_slots(roundUpToPowerOfTwo(capacity)),
+    m_mask(m_slots.size() - 1),
+    m_head(0),
+    m_tail(0)
+    {
+        for (std::size_t i = 0; i < m_slots.size(); ++i)
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // any thread; pushes all the elements or none of them, and returns the
+    // number of elements pushed
+    std::size_t push(const T* elements, std::size_t count)
+    {
+        if (count == 0 || count > m_slots.size())
+            return 0;
+
+        std::size_t tail = m_tail.load(std::memory_order_relaxed);
+        while (true)
+        {
+            // is the last slot of the batch free?
+            std::size_t last = tail + count - 1;
+            std::size_t sequence = m_slots[last & m_mask].sequence.load(std::memory_order_acquire);
+            if (sequence != last)
+            {
+                // full, or another producer moved the tail in the meantime
+                std::size_t current = m_tail.load(std::memory_order_relaxed);
+                if (current == tail)
+                    return 0;
+
+                tail = current;
+                continue;
+            }
+
+            // reserve the slots; on failure, tail receives the new value
+            if (m_tail.compare_exchange_weak(tail, tail + count, std::memory_order_relaxed))
+                break;
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            Slot& slot = m_slots[(tail + i) & m_mask];
+            slot.element = elements[i];
+            slot.sequence.store(tail + i + 1, std::memory_order_release);
+        }
+
+        return count;
+    }
+
+    bool push(const T& element)
+    {
+        return push(&element, 1) == 1;
+    }
+
+    // consumer only; returns the number of elements popped
+    std::size_t pop(T* elements, std::size_t count)
+    {
+        std::size_t popped = 0;
+        while (popped < count)
+        {
+            Slot& slot = m_slots[(m_head + popped) & m_mask];
+            if (slot.sequence.load(std::memory_order_acquire) != m_head + popped + 1)
+                break;
+
+            elements[popped] = slot.element;
+            slot.sequence.store(m_head + popped + m_slots.size(), std::memory_order_release);
+            ++popped;
+        }
+
+        m_head += popped;
+        return popped;
+    }
+
+    bool pop(T& element)
+    {
+        return pop(&element, 1) == 1;
+    }
+
+    std::size_t getCapacity() const
+    {
+        return m_slots.size();
+    }
+
+private:
+
+    struct Slot
+    {
+        std::atomic<std::size_t> sequence;
+        T element;
+    };
+
+    std::vector<Slot> m_slots;
+    std::size_t m_mask;
+
+    // only used by the consumer
+    alignas(CacheLineSize) std::size_t m_head;
+
+    // shared by all the producers
+    alignas(CacheLineSize) std::atomic<std::size_t> m_tail;
+};
+
+//The element type should be cheap to copy: a pointer, an index, or a small
+//struct. To pass big objects (a decoded sf::Image), pass a pointer and let the
+//receiver take ownership.
+
+//The queues never wait, so the waiting is left to their users. A consumer
+//which runs every frame, like the main thread, simply pops what is there. A
+//thread which has nothing else to do can pop in a loop with
+//std::this_thread::yield() or sf::sleep between tries, or sleep on a condition
+//variable that the producers notify -- which brings back the system, but only
+//when the queue is empty, not on every message.
+
+/* The mutex version
+
+This is the pattern that the queues replace: a std::vector protected by a
+sf::Mutex. The consumer swaps the whole vector with an empty one, so that the
+mutex is only held for a moment.*/
+template <typename T>
+class MutexQueue
+{
+public:
+
+    void push(const T* elements, std::size_t count)
+    {
+        sf::Lock lock(m_mutex);
+        m_elements.insert(m_elements.end(), elements, elements + count);
+    }
+
+    void popAll(std::vector<T>& elements)
+    {
+        elements.clear();
+
+        sf::Lock lock(m_mutex);
+        m_elements.swap(elements);
+    }
+
+private:
+
+    sf::Mutex m_mutex;
+    std::vector<T> m_elements;
+};
+
+/* Benchmark
+
+Each message is the time at which it was sent, in nanoseconds. The producers
+send their messages in batches of 16, as fast as the queue accepts them; the
+consumer pops everything it can, and measures for each message how long it
+waited, from push to pop. We print the number of messages per second, and the
+latencies at the 50th, 99th and 99.99th percentiles, and the worst one.
+
+The benchmark runs with one producer (a loading thread) and with three. Since
+the producers send as fast as they can, the latencies include the time spent
+waiting in the queue behind other messages; and with more threads than cores,
+the worst cases mostly measure how the system schedules the threads.*/
+typedef std::chrono::steady_clock SteadyClock;
+
+sf::Uint64 now()
+{
+    return static_cast<sf::Uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        SteadyClock::now().time_since_epoch()).count());
+}
+
+struct Result
+{
+    double messagesPerSecond;
+    std::vector<sf::Uint64> latencies;
+};
+
+void printResult(const char* name, Result& result)
+{
+    std::vector<sf::Uint64>& latencies = result.latencies;
+    std::sort(latencies.begin(), latencies.end());
+
+    std::size_t count = latencies.size();
+    std::cout << name << static_cast<int>(result.messagesPerSecond / 1000000) << " M/s, latency "
+              << latencies[count / 2] / 1000 << " / " << latencies[count * 99 / 100] / 1000 << " / "
+              << latencies[count * 9999 / 10000] / 1000 << " / " << latencies.back() / 1000
+              << " us (50% / 99% / 99.99% / max)" << std::endl;
+}
+
+const std::size_t messagesPerProducer = 2000000;
+const std::size_t batchSize = 16;
+
+// send the messages of a producer, retrying when the queue is full
+template <typename Queue>
+void produce(Queue& queue)
+{
+    sf::Uint64 batch[batchSize];
+    for (std::size_t sent = 0; sent < messagesPerProducer; sent += batchSize)
+    {
+        for (std::size_t i = 0; i < batchSize; ++i)
+            batch[i] = now();
+
+        std::size_t pushed = 0;
+        while (pushed < batchSize)
+        {
+            pushed += queue.push(batch + pushed, batchSize - pushed);
+            if (pushed < batchSize)
+                std::this_thread::yield();
+        }
+    }
+}
+
+template <typename Queue>
+Result benchmarkQueue(unsigned int producerCount)
+{
+    static Queue queue(4096);
+    Result result;
+    result.latencies.reserve(messagesPerProducer * producerCount);
+
+    SteadyClock::time_point start = SteadyClock::now();
+    std::vector<std::thread> producers;
+    for (unsigned int i = 0; i < producerCount; ++i)
+        producers.push_back(std::thread([]() { produce(queue); }));
+
+    sf::Uint64 messages[256];
+    while (result.latencies.size() < messagesPerProducer * producerCount)
+    {
+        std::size_t count = queue.pop(messages, 256);
+        sf::Uint64 time = now();
+        for (std::size_t i = 0; i < count; ++i)
+            result.latencies.push_back(time - messages[i]);
+
+        if (count == 0)
+            std::this_thread::yield();
+    }
+
+    for (std::size_t i = 0; i < producers.size(); ++i)
+        producers[i].join();
+
+    result.messagesPerSecond = result.latencies.size() / std::chrono::duration<double>(SteadyClock::now() - start).count();
+    return result;
+}
+
+Result benchmarkMutex(unsigned int producerCount)
+{
+    MutexQueue<sf::Uint64> queue;
+    Result result;
+    result.latencies.reserve(messagesPerProducer * producerCount);
+
+    SteadyClock::time_point start = SteadyClock::now();
+    std::vector<std::thread> producers;
+    for (unsigned int i = 0; i < producerCount; ++i)
+    {
+        producers.push_back(std::thread([&queue]()
+        {
+            sf::Uint64 batch[batchSize];
+            for (std::size_t sent = 0; sent < messagesPerProducer; sent += batchSize)
+            {
+                for (std::size_t j = 0; j < batchSize; ++j)
+                    batch[j] = now();
+                queue.push(batch, batchSize);
+            }
+        }));
+    }
+
+    std::vector<sf::Uint64> messages;
+    while (result.latencies.size() < messagesPerProducer * producerCount)
+    {
+        queue.popAll(messages);
+        sf::Uint64 time = now();
+        for (std::size_t i = 0; i < messages.size(); ++i)
+            result.latencies.push_back(time - messages[i]);
+
+        if (messages.empty())
+            std::this_thread::yield();
+    }
+
+    for (std::size_t i = 0; i < producers.size(); ++i)
+        producers[i].join();
+
+    result.messagesPerSecond = result.latencies.size() / std::chrono::duration<double>(SteadyClock::now() - start).count();
+    return result;
+}
+
+int main()
+{
+    std::cout << "1 producer" << std::endl;
+    Result mutex1 = benchmarkMutex(1);
+    printResult("  sf::Mutex + vector: ", mutex1);
+    Result spsc = benchmarkQueue<SpscQueue<sf::Uint64> >(1);
+    printResult("  SpscQueue:          ", spsc);
+    Result mpsc1 = benchmarkQueue<MpscQueue<sf::Uint64> >(1);
+    printResult("  MpscQueue:          ", mpsc1);
+
+    std::cout << "3 producers" << std::endl;
+    Result mutex3 = benchmarkMutex(3);
+    printResult("  sf::Mutex + vector: ", mutex3);
+    Result mpsc3 = benchmarkQueue<MpscQueue<sf::Uint64> >(3);
+    printResult("  MpscQueue:          ", mpsc3);
+
+    return 0;
+}
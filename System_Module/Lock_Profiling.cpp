@@ -0,0 +1,348 @@
+/* Measuring lock contention
+
+compile with:  g++ -std=c++11 -O2 -DPROFILE_LOCKS -c Lock_Profiling.cpp
+and then link to get the executable with:
+
+    g++ Lock_Profiling.o -o sfml-app -lsfml-system -pthread
+*/
+
+/* Introduction
+
+The threads tutorial explains that a thread which finds a sf::Mutex locked is
+put to sleep, and that a sleeping thread consumes no CPU. That's true, but
+while it sleeps, its work doesn't progress either. When a program doesn't get
+faster with more threads, the reason is often a mutex: the threads spend their
+time waiting for each other, one critical section at a time.
+
+A CPU profiler doesn't show this well, precisely because a waiting thread
+doesn't use the CPU. What we need is to measure, for each place in the code
+that locks a mutex:
+
+- how many times it locks it
+- how long it waits to get it (the contention)
+- how long it keeps it (the hold time, which makes the others wait)
+
+The profiler below replaces sf::Lock with a macro that does the same thing,
+and records these numbers, along with histograms of the wait and hold times:
+an average hides the rare long waits that make a frame late. At exit, it
+prints a report of all the places, sorted by total wait time: the first lines
+are the critical sections that limit the program.
+
+Profiling is enabled at compile time, by defining PROFILE_LOCKS. Without it,
+the macro is a plain sf::Lock, and costs nothing.*/
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* Using it
+
+Instead of
+
+    sf::Lock lock(mutex);
+
+write
+
+    PROFILED_LOCK(mutex);
+
+The macro creates a lock variable whose name depends on the line, so it can
+be used several times in the same function, but only once per line.*/
+#define LOCK_PROFILER_CONCAT_IMPL(a, b) a##b
+#define LOCK_PROFILER_CONCAT(a, b) LOCK_PROFILER_CONCAT_IMPL(a, b)
+
+#ifdef PROFILE_LOCKS
+
+    #define PROFILED_LOCK(mutex) \
+        static LockSite LOCK_PROFILER_CONCAT(lockSite, __LINE__)(__FILE__, __LINE__, #mutex); \
+        ProfiledLock LOCK_PROFILER_CONCAT(lock, __LINE__)(mutex, LOCK_PROFILER_CONCAT(lockSite, __LINE__))
+
+#else
+
+    #define PROFILED_LOCK(mutex) sf::Lock LOCK_PROFILER_CONCAT(lock, __LINE__)(mutex)
+
+#endif
+
+/* The statistics of a call site
+
+Each use of the macro declares a static LockSite: its statistics are shared by
+all the threads which run this line. They are updated with relaxed atomic
+operations, which never wait: the profiler must not add contention of its own.
+
+The histograms have one bucket per power of two nanoseconds: bucket 10 counts
+the durations between 1024 and 2047 ns, about 1 to 2 microseconds. This is
+precise enough to see whether a wait is a few microseconds (the mutex was free
+soon) or milliseconds (the thread was put to sleep behind a long critical
+section).
+
+Call sites add themselves to a global list the first time they are used; the
+first one also registers the function that prints the report at exit.*/
+class LockSite : sf::NonCopyable
+{
+public:
+
+    static const std::size_t BucketCount = 40;
+
+    struct Histogram
+    {
+        std::atomic<sf::Uint64> buckets[BucketCount];
+        std::atomic<sf::Uint64> total;   // nanoseconds
+        std::atomic<sf::Uint64> maximum;
+
+        void add(sf::Uint64 nanoseconds)
+        {
+            std::size_t bucket = 0;
+            while (bucket + 1 < BucketCount && (nanoseconds >> (bucket + 1)) != 0)
+                ++bucket;
+
+            buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+            total.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+            sf::Uint64 current = maximum.load(std::memory_order_relaxed);
+            while (nanoseconds > current && !maximum.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed))
+                ;
+        }
+
+        // an approximation: the upper bound of the bucket which contains the
+        // requested percentile
+        sf::Uint64 getPercentile(sf::Uint64 count, double percentile) const
+        {
+            sf::Uint64 target = static_cast<sf::Uint64>(count * percentile);
+            sf::Uint64 accumulated = 0;
+            for (std::size_t i = 0; i < BucketCount; ++i)
+            {
+                accumulated += buckets[i].load(std::memory_order_relaxed);
+                if (accumulated > target)
+                    return std::min<sf::Uint64>((2ULL << i) - 1, maximum.load(std::memory_order_relaxed));
+            }
+
+            return maximum.load(std::memory_order_relaxed);
+        }
+    };
+
+    LockSite(const char* file, int line, const char* mutex) :
+    file(file),
+    line(line),
+    mutex(mutex),
+    count(0),
+    next(NULL)
+    {
+        for (std::size_t i = 0; i < BucketCount; ++i)
+        {
+            wait.buckets[i] = 0;
+            hold.buckets[i] = 0;
+        }
+        wait.total = 0;
+        wait.maximum = 0;
+        hold.total = 0;
+        hold.maximum = 0;
+
+        // add this site to the list; the first one registers the report
+        LockSite* first = getFirst().load();
+        do
+        {
+            next = first;
+        }
+        while (!getFirst().compare_exchange_weak(first, this));
+
+        if (!next)
+            std::atexit(&printReport);
+    }
+
+    static std::atomic<LockSite*>& getFirst()
+    {
+        static std::atomic<LockSite*> first(NULL);
+        return first;
+    }
+
+    static void printReport();
+
+    const char* file;
+    int line;
+    const char* mutex;
+    std::atomic<sf::Uint64> count;
+    Histogram wait;
+    Histogram hold;
+    LockSite* next;
+};
+
+/* The profiled lock
+
+It does what sf::Lock does, and measures the time around mutex.lock() (the
+wait) and between lock and unlock (the hold). std::chrono::steady_clock costs
+a few tens of nanoseconds per call, which is small compared to a mutex that is
+contended -- the only case that matters here.*/
+class ProfiledLock : sf::NonCopyable
+{
+public:
+
+    ProfiledLock(sf::Mutex& mutex, LockSite& site) :
+    m_mutex(mutex),
+    m_site(site)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        m_mutex.lock();
+        m_acquired = std::chrono::steady_clock::now();
+
+        m_site.count.fetch_add(1, std::memory_order_relaxed);
+        m_site.wait.add(toNanoseconds(m_acquired - start));
+    }
+
+    ~ProfiledLock()
+    {
+        sf::Uint64 held = toNanoseconds(std::chrono::steady_clock::now() - m_acquired);
+        m_mutex.unlock();
+
+        m_site.hold.add(held);
+    }
+
+private:
+
+    static sf::Uint64 toNanoseconds(std::chrono::steady_clock::duration duration)
+    {
+        return static_cast<sf::Uint64>(std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count());
+    }
+
+    sf::Mutex& m_mutex;
+    LockSite& m_site;
+    std::chrono::steady_clock::time_point m_acquired;
+};
+
+/* The report
+
+One line per call site, sorted by total wait time, then a histogram of the
+wait times of the first site. Times are in microseconds; the percentiles are
+approximated from the histograms (within a factor of two).*/
+void LockSite::printReport()
+{
+    std::vector<const LockSite*> sites;
+    for (const LockSite* site = getFirst().load(); site; site = site->next)
+        sites.push_back(site);
+
+    std::sort(sites.begin(), sites.end(), [](const LockSite* left, const LockSite* right)
+    {
+        return left->wait.total.load() > right->wait.total.load();
+    });
+
+    std::fprintf(stderr, "\nLock contention report, sorted by total wait (times in us)\n\n");
+    std::fprintf(stderr, "%-36s %10s %12s %9s %9s %9s %12s %9s %9s\n", "call site", "locks", "wait total",
+                 "wait p50", "wait p99", "wait max", "hold total", "hold p99", "hold max");
+
+    for (std::size_t i = 0; i < sites.size(); ++i)
+    {
+        const LockSite& site = *sites[i];
+        sf::Uint64 count = site.count.load();
+        if (count == 0)
+            continue;
+
+        // the file name without its directory
+        std::string name = site.file;
+        name = name.substr(name.find_last_of("/\\") + 1) + ":" + std::to_string(site.line) + " " + site.mutex;
+
+        std::fprintf(stderr, "%-36s %10llu %12.0f %9.1f %9.1f %9.1f %12.0f %9.1f %9.1f\n", name.c_str(),
+                     static_cast<unsigned long long>(count), site.wait.total.load() / 1000.0,
+                     site.wait.getPercentile(count, 0.5) / 1000.0, site.wait.getPercentile(count, 0.99) / 1000.0,
+                     site.wait.maximum.load() / 1000.0, site.hold.total.load() / 1000.0,
+                     site.hold.getPercentile(count, 0.99) / 1000.0, site.hold.maximum.load() / 1000.0);
+    }
+
+    if (sites.empty() || sites[0]->count.load() == 0)
+        return;
+
+    // the distribution of the wait times of the worst site
+    const LockSite& worst = *sites[0];
+    sf::Uint64 largest = 1;
+    for (std::size_t i = 0; i < BucketCount; ++i)
+        largest = std::max<sf::Uint64>(largest, worst.wait.buckets[i].load());
+
+    std::fprintf(stderr, "\nwait times of %s:%d %s\n", worst.file, worst.line, worst.mutex);
+    for (std::size_t i = 0; i < BucketCount; ++i)
+    {
+        sf::Uint64 value = worst.wait.buckets[i].load();
+        if (value > 0)
+            std::fprintf(stderr, "  < %12.3f us %10llu %s\n", (2ULL << i) / 1000.0, static_cast<unsigned long long>(value),
+                         std::string(static_cast<std::size_t>(50 * value / largest), '#').c_str());
+    }
+}
+
+//The report is printed by a function registered with std::atexit, so it only
+//appears when the program ends normally (returning from main, or calling
+//std::exit). LockSite::printReport can also be called at any time, for
+//example when a key is pressed.
+
+//Only the locks written with the macro are measured. Calls to mutex.lock()
+//and mutex.unlock() are not: converting them to a scoped lock is a good idea
+//anyway, as the threads tutorial explains.
+
+//Reading the report: a high wait total with a low hold time means that many
+//threads want the mutex at the same time -- lock less often (by batching the
+//work), or give each thread its own data. A high hold time means that the
+//critical section does too much: prepare the work before locking, and only
+//publish the result while the mutex is locked.
+
+/* A demo
+
+Four threads add results to a shared list. The first version computes each
+result while it holds the mutex; the second one computes it before locking,
+and holds the mutex only to add it. Compiled with -DPROFILE_LOCKS, the report
+shows the difference; without it, the program runs normally and prints only
+its timings.*/
+sf::Mutex resultsMutex;
+std::vector<double> results;
+
+double compute(int i)
+{
+    double value = i;
+    for (int j = 0; j < 2000; ++j)
+        value = value * 0.999 + j;
+    return value;
+}
+
+void computeWhileLocked(int i)
+{
+    PROFILED_LOCK(resultsMutex);
+    results.push_back(compute(i));
+}
+
+void computeThenLock(int i)
+{
+    double value = compute(i);
+
+    PROFILED_LOCK(resultsMutex);
+    results.push_back(value);
+}
+
+void run(const char* name, void (*function)(int))
+{
+    results.clear();
+    sf::Clock clock;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.push_back(std::thread([function, t]()
+        {
+            for (int i = 0; i < 5000; ++i)
+                function(t * 5000 + i);
+        }));
+    }
+
+    for (std::size_t i = 0; i < threads.size(); ++i)
+        threads[i].join();
+
+    std::cout << name << clock.getElapsedTime().asMilliseconds() << " ms" << std::endl;
+}
+
+int main()
+{
+    run("compute while locked: ", &computeWhileLocked);
+    run("compute, then lock:   ", &computeThenLock);
+
+    return 0;
+}
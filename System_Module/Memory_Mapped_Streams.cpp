@@ -0,0 +1,289 @@
+/* Reading files through memory mapping
+
+compile with:  g++ -O2 -c Memory_Mapped_Streams.cpp
+and then link to get the executable with:
+
+    g++ Memory_Mapped_Streams.o -o sfml-app -lsfml-system
+*/
+
+/* Introduction
+
+sf::FileInputStream, seen in the user data streams tutorial, is built on the
+stdio functions: every read goes through fread, which copies the data from the
+operating system into the stdio buffer, then from the stdio buffer into our
+buffer. For big assets (music, large textures, packed data files) these copies
+add up.
+
+Memory mapping asks the operating system to make the file itself appear in our
+address space. Reading from the file is then reading from memory: the pages of
+the file are loaded on demand the first time they are touched, directly from
+the system's file cache, without any intermediate buffer. A stream built on a
+mapping:
+
+- serves read with a single memcpy from the mapped pages
+- can give direct access to the whole content (getData), so that functions
+  which accept memory, like loadFromMemory, don't need any copy at all
+- can tell the system how the file will be read (madvise), so that it reads
+  ahead aggressively for sequential reads, or not at all for random ones
+
+Memory mapping is done with the POSIX functions mmap, madvise and munmap here
+(Linux, macOS). On Windows, CreateFileMapping and MapViewOfFile do the same
+thing, and PrefetchVirtualMemory replaces MADV_WILLNEED.*/
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The mapped file stream
+
+The file descriptor is closed as soon as the file is mapped: the mapping keeps
+the file alive by itself. Like sf::MemoryInputStream, seek clamps the position
+to the size of the data.*/
+class MappedFileStream : public sf::InputStream, sf::NonCopyable
+{
+public:
+
+    enum Access
+    {
+        Sequential, // read from the beginning to the end (music, images)
+        Random      // read here and there (fonts, archives)
+    };
+
+    MappedFileStream() :
+    m_data(NULL),
+    m_size(0),
+    m_offset(0),
+    m_isOpen(false)
+    {
+    }
+
+    ~MappedFileStream()
+    {
+        close();
+    }
+
+    bool open(const std::string& filename, Access access = Sequential)
+    {
+        close();
+
+        int file = ::open(filename.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(file, &status) != 0)
+        {
+            ::close(file);
+            return false;
+        }
+
+        // an empty file can't be mapped, but it's still a valid stream
+        if (status.st_size > 0)
+        {
+            void* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+            if (mapping == MAP_FAILED)
+            {
+                ::close(file);
+                return false;
+            }
+
+            m_data = static_cast<const char*>(mapping);
+            m_size = status.st_size;
+
+            // sequential: read ahead aggressively, and free the pages that
+            // were read; random: don't read more than the requested pages
+            madvise(mapping, m_size, access == Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        }
+
+        ::close(file);
+        m_offset = 0;
+        m_isOpen = true;
+
+        return true;
+    }
+
+    void close()
+    {
+        if (m_data)
+            munmap(const_cast<char*>(m_data), m_size);
+
+        m_data = NULL;
+        m_size = 0;
+        m_offset = 0;
+        m_isOpen = false;
+    }
+
+    virtual sf::Int64 read(void* data, sf::Int64 size)
+    {
+        if (!m_isOpen)
+            return -1;
+
+        sf::Int64 count = std::max<sf::Int64>(0, std::min(size, m_size - m_offset));
+        if (count > 0)
+        {
+            std::memcpy(data, m_data + m_offset, static_cast<std::size_t>(count));
+            m_offset += count;
+        }
+
+        return count;
+    }
+
+    virtual sf::Int64 seek(sf::Int64 position)
+    {
+        if (!m_isOpen)
+            return -1;
+
+        m_offset = std::max<sf::Int64>(0, std::min(position, m_size));
+        return m_offset;
+    }
+
+    virtual sf::Int64 tell()
+    {
+        return m_isOpen ? m_offset : -1;
+    }
+
+    virtual sf::Int64 getSize()
+    {
+        return m_isOpen ? m_size : -1;
+    }
+
+    // direct access to the whole content, without any copy; valid until the
+    // stream is closed or destroyed
+    const void* getData() const
+    {
+        return m_data;
+    }
+
+    // ask the system to start loading a range of the file now, in the
+    // background, because it will be read soon
+    void prefetch(sf::Int64 offset, sf::Int64 size)
+    {
+        if (!m_data || offset >= m_size)
+            return;
+
+        // madvise needs an address aligned on a page
+        sf::Int64 pageSize = sysconf(_SC_PAGESIZE);
+        sf::Int64 start = offset / pageSize * pageSize;
+        sf::Int64 end = std::min(offset + size, m_size);
+
+        madvise(const_cast<char*>(m_data) + start, static_cast<std::size_t>(end - start), MADV_WILLNEED);
+    }
+
+private:
+
+    const char* m_data;
+    sf::Int64 m_size;
+    sf::Int64 m_offset;
+    bool m_isOpen;
+};
+
+//getData is what makes the biggest difference: a texture can be decoded
+//straight from the mapped file, and no buffer holds a copy of the file.
+//
+//    MappedFileStream stream;
+//    if (stream.open("background.png"))
+//        texture.loadFromMemory(stream.getData(), stream.getSize());
+
+//sf::Music and sf::Font keep reading from their stream as long as they are
+//used: with a mapped stream, these reads are memory copies, which never wait
+//for the disk once the pages are loaded. As with any stream, keep it alive as
+//long as the resource uses it (see the common mistakes of the user data streams
+//tutorial).
+
+//A mapping reserves address space for the whole file, which is no problem on
+//64-bit systems. On 32-bit systems, files of several hundreds of megabytes may
+//not fit.
+
+/* Benchmark
+
+Let's read a 256 MB file in 64 KB chunks, the way sf::Music reads its stream,
+with sf::FileInputStream and with our stream, then without copying at all. A
+checksum makes sure that all the data is really read, and that both give the
+same result.
+
+The file is read once before measuring, so that all the runs read it from the
+system's file cache: this measures the cost of the copies, not the speed of the
+disk. To measure cold reads, drop the file cache between the runs (on Linux:
+echo 3 > /proc/sys/vm/drop_caches, as root).*/
+sf::Uint32 checksum(const char* data, std::size_t size, sf::Uint32 sum)
+{
+    for (std::size_t i = 0; i < size; i += 64)
+        sum = sum * 31 + static_cast<unsigned char>(data[i]);
+    return sum;
+}
+
+sf::Uint32 readInChunks(sf::InputStream& stream)
+{
+    std::vector<char> buffer(64 * 1024);
+    sf::Uint32 sum = 0;
+
+    stream.seek(0);
+    sf::Int64 count;
+    while ((count = stream.read(&buffer[0], buffer.size())) > 0)
+        sum = checksum(&buffer[0], static_cast<std::size_t>(count), sum);
+
+    return sum;
+}
+
+int main()
+{
+    const std::string filename = "large_asset.bin";
+    const std::size_t size = 256 * 1024 * 1024;
+
+    // create the test file if it doesn't exist yet
+    sf::FileInputStream existing;
+    if (!existing.open(filename) || existing.getSize() != static_cast<sf::Int64>(size))
+    {
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file)
+            return -1;
+
+        std::vector<char> block(1024 * 1024);
+        for (std::size_t i = 0; i < size / block.size(); ++i)
+        {
+            for (std::size_t j = 0; j < block.size(); ++j)
+                block[j] = static_cast<char>(i * 7 + j);
+            std::fwrite(&block[0], 1, block.size(), file);
+        }
+        std::fclose(file);
+    }
+
+    sf::FileInputStream fileStream;
+    MappedFileStream mappedStream;
+    if (!fileStream.open(filename) || !mappedStream.open(filename))
+        return -1;
+
+    // warm up the file cache
+    readInChunks(fileStream);
+
+    sf::Clock clock;
+    sf::Uint32 fileSum = readInChunks(fileStream);
+    sf::Time fileTime = clock.restart();
+
+    sf::Uint32 mappedSum = readInChunks(mappedStream);
+    sf::Time mappedTime = clock.restart();
+
+    sf::Uint32 directSum = 0;
+    for (std::size_t offset = 0; offset < size; offset += 64 * 1024)
+        directSum = checksum(static_cast<const char*>(mappedStream.getData()) + offset,
+                             std::min<std::size_t>(64 * 1024, size - offset), directSum);
+    sf::Time directTime = clock.restart();
+
+    std::cout << "sf::FileInputStream: " << fileTime.asMilliseconds() << " ms" << std::endl;
+    std::cout << "MappedFileStream:    " << mappedTime.asMilliseconds() << " ms" << std::endl;
+    std::cout << "getData (no copy):   " << directTime.asMilliseconds() << " ms" << std::endl;
+
+    if (fileSum != mappedSum || fileSum != directSum)
+        std::cout << "MISMATCH" << std::endl;
+
+    return 0;
+}
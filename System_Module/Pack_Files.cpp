@@ -0,0 +1,578 @@
+/* Packing assets into a single file
+
+compile with:  g++ -std=c++11 -c Pack_Files.cpp
+and then link to get the executable with:
+
+    g++ Pack_Files.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system
+*/
+
+/* Introduction
+
+A game with thousands of small assets opens thousands of files at startup:
+for each one, the system looks up the path, checks permissions, allocates a
+file descriptor, reads, and closes. These system calls cost more than reading
+the (small) data itself, especially on Windows and on slow file systems.
+
+The user data streams tutorial mentions the solution: put the resources "in a
+big data file". This tutorial builds one:
+
+- a pack file starts with a table of contents (TOC): a hash table that gives,
+  for each asset path, where its data is in the file, so finding an asset
+  costs one hash and usually one comparison, whatever the number of assets
+- the data of each asset follows, aligned on 16 bytes (or more, for example a
+  page, if the data is used in place by code that needs it)
+- the reader opens and maps the pack file once; opening an asset creates a
+  small sf::InputStream that reads from the mapping, which can be passed to
+  any loadFromStream or openFromStream function, without any system call
+
+The tutorial also includes the command-line packer that creates pack files.
+Memory mapping is done with the POSIX functions, like in the memory mapped
+streams tutorial.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* The file format
+
+All the numbers are stored little-endian, which is the byte order of all the
+platforms that SFML supports.
+
+    Header
+    Slot[slotCount]      the hash table, slotCount is a power of two
+    char[namesSize]      the paths of the entries, one after the other
+    (padding)
+    data                 the content of the entries, each one aligned
+
+A slot whose nameLength is 0 is empty. A path is found by hashing it (64-bit
+FNV-1a), and probing the slots from hash % slotCount until the path or an
+empty slot is found. The table is never more than half full, so probing is
+short.*/
+namespace pack
+{
+    struct Header
+    {
+        char magic[4];
+        sf::Uint32 version;
+        sf::Uint32 alignment;
+        sf::Uint32 entryCount;
+        sf::Uint32 slotCount;
+        sf::Uint32 namesSize;
+        sf::Uint64 dataOffset;
+    };
+
+    struct Slot
+    {
+        sf::Uint64 hash;
+        sf::Uint64 offset;      // from the beginning of the file
+        sf::Uint64 size;
+        sf::Uint32 nameOffset;  // in the names
+        sf::Uint32 nameLength;
+    };
+
+    sf::Uint64 hash(const char* path, std::size_t length)
+    {
+        sf::Uint64 hash = 14695981039346656037ULL;
+        for (std::size_t i = 0; i < length; ++i)
+        {
+            hash ^= static_cast<unsigned char>(path[i]);
+            hash *= 1099511628211ULL;
+        }
+        return hash;
+    }
+
+    sf::Uint64 alignUp(sf::Uint64 value, sf::Uint64 alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+}
+
+/* Entry streams
+
+An entry stream is just a pointer to the data of the entry in the mapping, its
+size, and the current position: it's cheap to create, and many of them can be
+open at the same time, in any thread, since they only read memory.*/
+class PackEntryStream : public sf::InputStream
+{
+public:
+
+    PackEntryStream() :
+    m_data(NULL),
+    m_size(-1),
+    m_offset(0)
+    {
+    }
+
+    virtual sf::Int64 read(void* data, sf::Int64 size)
+    {
+        if (m_size < 0)
+            return -1;
+
+        sf::Int64 count = std::max<sf::Int64>(0, std::min(size, m_size - m_offset));
+        if (count > 0)
+        {
+            std::memcpy(data, m_data + m_offset, static_cast<std::size_t>(count));
+            m_offset += count;
+        }
+
+        return count;
+    }
+
+    virtual sf::Int64 seek(sf::Int64 position)
+    {
+        if (m_size < 0)
+            return -1;
+
+        m_offset = std::max<sf::Int64>(0, std::min(position, m_size));
+        return m_offset;
+    }
+
+    virtual sf::Int64 tell()
+    {
+        return m_size < 0 ? -1 : m_offset;
+    }
+
+    virtual sf::Int64 getSize()
+    {
+        return m_size;
+    }
+
+private:
+
+    friend class PackFile;
+
+    const char* m_data;
+    sf::Int64 m_size;
+    sf::Int64 m_offset;
+};
+
+/* The pack file reader
+
+Opening the pack is the only file operation: one open, one mmap, and the file
+descriptor is closed right away. The TOC is then used directly from the
+mapping, nothing is copied or parsed, so opening a pack of 10000 entries is as
+fast as opening a pack of 10.*/
+class PackFile : sf::NonCopyable
+{
+public:
+
+    PackFile() :
+    m_data(NULL),
+    m_size(0),
+    m_header(NULL),
+    m_slots(NULL),
+    m_names(NULL)
+    {
+    }
+
+    ~PackFile()
+    {
+        close();
+    }
+
+    bool open(const std::string& filename)
+    {
+        close();
+
+        int file = ::open(filename.c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat status;
+        if (fstat(file, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(pack::Header)))
+        {
+            ::close(file);
+            return false;
+        }
+
+        void* mapping = mmap(NULL, status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+        ::close(file);
+        if (mapping == MAP_FAILED)
+            return false;
+
+        // assets are read here and there
+        madvise(mapping, status.st_size, MADV_RANDOM);
+
+        m_data = static_cast<const char*>(mapping);
+        m_size = static_cast<sf::Uint64>(status.st_size);
+
+        if (!validate())
+        {
+            std::cerr << "Invalid pack file " << filename << std::endl;
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if (m_data)
+            munmap(const_cast<char*>(m_data), m_size);
+
+        m_data = NULL;
+        m_size = 0;
+        m_header = NULL;
+        m_slots = NULL;
+        m_names = NULL;
+    }
+
+    std::size_t getEntryCount() const
+    {
+        return m_header ? m_header->entryCount : 0;
+    }
+
+    bool contains(const std::string& path) const
+    {
+        return find(path) != NULL;
+    }
+
+    // open an entry; the stream stays valid as long as the pack file is open
+    bool openEntry(const std::string& path, PackEntryStream& stream) const
+    {
+        const pack::Slot* slot = find(path);
+        if (!slot)
+            return false;
+
+        stream.m_data = m_data + slot->offset;
+        stream.m_size = static_cast<sf::Int64>(slot->size);
+        stream.m_offset = 0;
+        return true;
+    }
+
+    // direct access to the data of an entry, for loadFromMemory functions
+    const void* getEntryData(const std::string& path, std::size_t& size) const
+    {
+        const pack::Slot* slot = find(path);
+        if (!slot)
+            return NULL;
+
+        size = static_cast<std::size_t>(slot->size);
+        return m_data + slot->offset;
+    }
+
+    // the paths of all the entries, in no particular order
+    std::vector<std::string> getEntryPaths() const
+    {
+        std::vector<std::string> paths;
+        for (sf::Uint32 i = 0; m_header && i < m_header->slotCount; ++i)
+        {
+            if (m_slots[i].nameLength > 0)
+                paths.push_back(std::string(m_names + m_slots[i].nameOffset, m_slots[i].nameLength));
+        }
+        return paths;
+    }
+
+private:
+
+    const pack::Slot* find(const std::string& path) const
+    {
+        if (!m_header || path.empty())
+            return NULL;
+
+        sf::Uint64 hash = pack::hash(path.data(), path.size());
+        sf::Uint32 mask = m_header->slotCount - 1;
+
+        for (sf::Uint32 i = static_cast<sf::Uint32>(hash) & mask; ; i = (i + 1) & mask)
+        {
+            const pack::Slot& slot = m_slots[i];
+            if (slot.nameLength == 0)
+                return NULL;
+
+            if (slot.hash == hash && slot.nameLength == path.size() &&
+                std::memcmp(m_names + slot.nameOffset, path.data(), path.size()) == 0)
+                return &slot;
+        }
+    }
+
+    // a damaged or truncated pack file must not make us read outside the
+    // mapping
+    bool validate()
+    {
+        m_header = reinterpret_cast<const pack::Header*>(m_data);
+        if (std::memcmp(m_header->magic, "SFPK", 4) != 0 || m_header->version != 1)
+            return false;
+
+        sf::Uint32 slotCount = m_header->slotCount;
+        if (slotCount == 0 || (slotCount & (slotCount - 1)) != 0 || m_header->entryCount >= slotCount)
+            return false;
+
+        sf::Uint64 namesOffset = sizeof(pack::Header) + static_cast<sf::Uint64>(slotCount) * sizeof(pack::Slot);
+        if (namesOffset + m_header->namesSize > m_size)
+            return false;
+
+        m_slots = reinterpret_cast<const pack::Slot*>(m_data + sizeof(pack::Header));
+        m_names = m_data + namesOffset;
+
+        // find stops at the first empty slot, so there must be one
+        sf::Uint32 used = 0;
+        for (sf::Uint32 i = 0; i < slotCount; ++i)
+        {
+            const pack::Slot& slot = m_slots[i];
+            if (slot.nameLength == 0)
+                continue;
+
+            if (static_cast<sf::Uint64>(slot.nameOffset) + slot.nameLength > m_header->namesSize ||
+                slot.offset > m_size || slot.size > m_size - slot.offset)
+                return false;
+
+            ++used;
+        }
+
+        return used < slotCount;
+    }
+
+    const char* m_data;
+    sf::Uint64 m_size;
+    const pack::Header* m_header;
+    const pack::Slot* m_slots;
+    const char* m_names;
+};
+
+/* The packer
+
+The packer takes a list of files and directories (which are added
+recursively), and stores each file under its path, with '/' as separator. It
+first collects the sizes of the files to compute the whole layout, then writes
+the TOC, and finally copies the files one after the other.*/
+namespace pack
+{
+    struct Input
+    {
+        std::string path;
+        sf::Uint64 size;
+        sf::Uint64 offset;
+    };
+
+    void collect(const std::string& path, std::vector<Input>& inputs)
+    {
+        struct stat status;
+        if (stat(path.c_str(), &status) != 0)
+        {
+            std::cerr << "Cannot find " << path << std::endl;
+            return;
+        }
+
+        if (S_ISDIR(status.st_mode))
+        {
+            DIR* directory = opendir(path.c_str());
+            if (!directory)
+                return;
+
+            while (dirent* entry = readdir(directory))
+            {
+                std::string name = entry->d_name;
+                if (name != "." && name != "..")
+                    collect(path + "/" + name, inputs);
+            }
+
+            closedir(directory);
+        }
+        else if (S_ISREG(status.st_mode))
+        {
+            Input input;
+            input.path = path;
+            std::replace(input.path.begin(), input.path.end(), '\\', '/');
+            input.size = static_cast<sf::Uint64>(status.st_size);
+            input.offset = 0;
+            inputs.push_back(input);
+        }
+    }
+
+    bool write(const std::string& filename, const std::vector<std::string>& paths, sf::Uint32 alignment = 16)
+    {
+        if (alignment == 0)
+        {
+            std::cerr << "The alignment must be at least 1" << std::endl;
+            return false;
+        }
+
+        std::vector<Input> inputs;
+        for (std::size_t i = 0; i < paths.size(); ++i)
+            collect(paths[i], inputs);
+
+        // sorting makes the pack reproducible, and stores the files of the
+        // same directory next to each other
+        std::sort(inputs.begin(), inputs.end(),
+                  [](const Input& left, const Input& right) { return left.path < right.path; });
+        inputs.erase(std::unique(inputs.begin(), inputs.end(),
+                                 [](const Input& left, const Input& right) { return left.path == right.path; }),
+                     inputs.end());
+
+        // the TOC
+        sf::Uint32 slotCount = 1;
+        while (slotCount < inputs.size() * 2 + 1)
+            slotCount *= 2;
+
+        std::vector<Slot> slots(slotCount);
+        std::memset(&slots[0], 0, slots.size() * sizeof(Slot));
+        std::string names;
+
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+            names += inputs[i].path;
+
+        Header header;
+        std::memcpy(header.magic, "SFPK", 4);
+        header.version = 1;
+        header.alignment = alignment;
+        header.entryCount = static_cast<sf::Uint32>(inputs.size());
+        header.slotCount = slotCount;
+        header.namesSize = static_cast<sf::Uint32>(names.size());
+        header.dataOffset = alignUp(sizeof(Header) + slots.size() * sizeof(Slot) + names.size(), alignment);
+
+        sf::Uint64 offset = header.dataOffset;
+        sf::Uint32 nameOffset = 0;
+        for (std::size_t i = 0; i < inputs.size(); ++i)
+        {
+            Input& input = inputs[i];
+            input.offset = alignUp(offset, alignment);
+            offset = input.offset + input.size;
+
+            sf::Uint64 inputHash = hash(input.path.data(), input.path.size());
+            sf::Uint32 index = static_cast<sf::Uint32>(inputHash) & (slotCount - 1);
+            while (slots[index].nameLength != 0)
+                index = (index + 1) & (slotCount - 1);
+
+            Slot& slot = slots[index];
+            slot.hash = inputHash;
+            slot.offset = input.offset;
+            slot.size = input.size;
+            slot.nameOffset = nameOffset;
+            slot.nameLength = static_cast<sf::Uint32>(input.path.size());
+            nameOffset += slot.nameLength;
+        }
+
+        std::FILE* file = std::fopen(filename.c_str(), "wb");
+        if (!file)
+            return false;
+
+        // every write is checked: a full disk must not leave a truncated pack
+        bool written = std::fwrite(&header, sizeof(header), 1, file) == 1 &&
+                       std::fwrite(&slots[0], sizeof(Slot), slots.size(), file) == slots.size() &&
+                       (names.empty() || std::fwrite(names.data(), 1, names.size(), file) == names.size());
+
+        // the data, with zeros for the padding
+        sf::Uint64 position = sizeof(Header) + slots.size() * sizeof(Slot) + names.size();
+        std::vector<char> buffer(1024 * 1024);
+        bool success = true;
+
+        for (std::size_t i = 0; i < inputs.size() && success && written; ++i)
+        {
+            const Input& input = inputs[i];
+            std::vector<char> padding(static_cast<std::size_t>(input.offset - position), 0);
+            if (!padding.empty())
+                written = std::fwrite(&padding[0], 1, padding.size(), file) == padding.size();
+
+            std::FILE* source = written ? std::fopen(input.path.c_str(), "rb") : NULL;
+            sf::Uint64 copied = 0;
+            std::size_t count;
+            while (source && written && (count = std::fread(&buffer[0], 1, buffer.size(), source)) > 0)
+            {
+                written = std::fwrite(&buffer[0], 1, count, file) == count;
+                copied += count;
+            }
+
+            // the file was modified since its size was read
+            if (written && (!source || copied != input.size))
+            {
+                std::cerr << "Cannot read " << input.path << std::endl;
+                success = false;
+            }
+
+            if (source)
+                std::fclose(source);
+            position = input.offset + input.size;
+        }
+
+        // fclose flushes the last buffered data, which can fail too
+        if (std::fclose(file) != 0)
+            written = false;
+
+        if (!written)
+            std::cerr << "Cannot write " << filename << std::endl;
+
+        if (!written || !success)
+        {
+            std::remove(filename.c_str());
+            return false;
+        }
+
+        std::cout << inputs.size() << " files packed into " << filename << std::endl;
+        return true;
+    }
+}
+
+//Paths are looked up exactly as they were stored: "textures/player.png" and
+//"./textures/player.png" are different entries. Run the packer from the
+//directory that your game uses as its working directory, and pass relative
+//paths.
+
+//A pack file can't be modified: to change an asset, create the pack again. For
+//quick iteration during development, fall back to loadFromFile when an asset is
+//not found in the pack.
+
+/* The command line, and a demo
+
+    sfml-app pack assets.pak textures fonts sounds     creates a pack
+    sfml-app list assets.pak                           lists its entries
+    sfml-app                                           runs the demo
+
+The demo loads a texture from the pack, without opening any other file. */
+int main(int argc, char* argv[])
+{
+    if (argc >= 3 && std::string(argv[1]) == "pack")
+        return pack::write(argv[2], std::vector<std::string>(argv + 3, argv + argc)) ? 0 : 1;
+
+    PackFile archive;
+
+    if (argc >= 3 && std::string(argv[1]) == "list")
+    {
+        if (!archive.open(argv[2]))
+            return 1;
+
+        std::vector<std::string> paths = archive.getEntryPaths();
+        std::sort(paths.begin(), paths.end());
+        for (std::size_t i = 0; i < paths.size(); ++i)
+            std::cout << paths[i] << std::endl;
+        return 0;
+    }
+
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Pack files");
+
+    if (!archive.open("assets.pak"))
+        return -1;
+
+    PackEntryStream stream;
+    sf::Texture texture;
+    if (!archive.openEntry("textures/player.png", stream) || !texture.loadFromStream(stream))
+        return -1;
+
+    sf::Sprite sprite(texture);
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+        }
+
+        window.clear();
+        window.draw(sprite);
+        window.display();
+    }
+
+    return 0;
+}
@@ -0,0 +1,414 @@
+/* Reading ahead in a background thread
+
+compile with:  g++ -std=c++11 -c Read_Ahead_Streams.cpp
+and then link to get the executable with:
+
+    g++ Read_Ahead_Streams.o -o sfml-app -lsfml-system -pthread
+*/
+
+/* Introduction
+
+As the common mistakes section of the user data streams tutorial explains,
+sf::Music and sf::Font don't read their stream once: they keep reading from it
+as long as they are used. sf::Music reads its samples from its own streaming
+thread, a little before they are played, and sf::Font reads the font file from
+the thread that draws texts, every time a new glyph is needed. If the data
+comes from a slow disk, a network drive or an optical disc, each of these reads
+may wait several milliseconds, and the sound stutters or the frame hitches.
+
+A read-ahead stream sits between the consumer and the real stream. A
+background thread reads from the real stream, ahead of the current position,
+into a ring buffer. As long as the consumer reads sequentially, which is what
+music does, its reads are served from memory and never wait for the disk.
+
+Not all reads are sequential: a font jumps here and there. When a read falls
+outside the buffered data, the stream restarts reading ahead from the new
+position, but only a little at first; each read that then continues where the
+previous one stopped doubles the amount that is read ahead, up to the size of
+the buffer. So random reads don't trigger large useless reads, and sequential
+reads quickly get the full benefit.
+
+The background thread is a std::thread, and it is woken up with a
+std::condition_variable, since sf::Thread and sf::Mutex don't provide a way to
+wait for a condition.*/
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* The read-ahead stream
+
+The buffered data is the range [m_start, m_start + m_filled) of the source,
+stored in the ring buffer from index m_head. The consumer only takes data from
+the beginning of this range (and discards what is behind its position), the
+reader thread only appends data at its end, so they never touch the same
+bytes.
+
+The reader thread is the only one that uses the source stream: sf::InputStream
+implementations are not meant to be used from several threads at once.*/
+class ReadAheadStream : public sf::InputStream, sf::NonCopyable
+{
+public:
+
+    // capacity is the size of the ring buffer, chunkSize the size of each
+    // read from the source
+    explicit ReadAheadStream(std::size_t capacity = 1024 * 1024, std::size_t chunkSize = 64 * 1024) :
+    m_source(NULL),
+    m_size(-1),
+    m_position(0),
+    m_buffer(capacity),
+    m_chunkSize(std::min(chunkSize, capacity)),
+    m_head(0),
+    m_start(0),
+    m_filled(0),
+    m_limit(m_chunkSize),
+    m_generation(0),
+    m_endOfStream(false),
+    m_error(false),
+    m_stop(false),
+    m_missCount(0)
+    {
+    }
+
+    ~ReadAheadStream()
+    {
+        close();
+    }
+
+    // the source must stay alive until the stream is closed or destroyed
+    bool open(sf::InputStream& source)
+    {
+        close();
+
+        m_size = source.getSize();
+        if (m_size < 0 || source.seek(0) != 0)
+        {
+            m_size = -1;
+            return false;
+        }
+
+        m_source = &source;
+        m_position = 0;
+        m_head = 0;
+        m_start = 0;
+        m_filled = 0;
+        m_limit = m_chunkSize;
+        m_endOfStream = false;
+        m_error = false;
+        m_stop = false;
+        m_thread = std::thread(&ReadAheadStream::readAhead, this);
+
+        return true;
+    }
+
+    void close()
+    {
+        if (m_thread.joinable())
+        {
+            {
+                std::lock_guard<std::mutex> lock(m_mutex);
+                m_stop = true;
+            }
+            m_dataWanted.notify_one();
+            m_thread.join();
+        }
+
+        m_source = NULL;
+        m_size = -1;
+    }
+
+    virtual sf::Int64 read(void* data, sf::Int64 size)
+    {
+        if (!m_source)
+            return -1;
+
+        char* output = static_cast<char*>(data);
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        sf::Int64 count = std::max<sf::Int64>(0, std::min(size, m_size - m_position));
+        sf::Int64 done = 0;
+
+        while (done < count)
+        {
+            if (m_position < m_start || m_position > m_start + static_cast<sf::Int64>(m_filled))
+            {
+                // outside the buffered data: read ahead from here, but only a
+                // little until the reads look sequential again
+                restart(m_position);
+                m_limit = m_chunkSize;
+                ++m_missCount;
+                m_dataWanted.notify_one();
+            }
+
+            // drop what is behind the position
+            discard(static_cast<std::size_t>(m_position - m_start));
+
+            if (m_filled == 0)
+            {
+                if (m_endOfStream || m_error)
+                    break;
+
+                m_dataAvailable.wait(lock);
+                continue;
+            }
+
+            // copy what is available (in up to two parts, since the buffer is
+            // a ring)
+            std::size_t available = std::min(m_filled, static_cast<std::size_t>(count - done));
+            std::size_t first = std::min(available, m_buffer.size() - m_head);
+            std::memcpy(output + done, &m_buffer[m_head], first);
+            std::memcpy(output + done + first, &m_buffer[0], available - first);
+
+            m_position += available;
+            done += available;
+            discard(available);
+
+            // sequential read: read further ahead
+            m_limit = std::min(m_limit * 2, m_buffer.size());
+            m_dataWanted.notify_one();
+        }
+
+        if (done == 0 && m_error)
+            return -1;
+
+        return done;
+    }
+
+    // seeking doesn't wait for anything: it's the next read that decides
+    // whether the buffered data can be used
+    virtual sf::Int64 seek(sf::Int64 position)
+    {
+        if (!m_source)
+            return -1;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_position = std::max<sf::Int64>(0, std::min(position, m_size));
+        return m_position;
+    }
+
+    virtual sf::Int64 tell()
+    {
+        if (!m_source)
+            return -1;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_position;
+    }
+
+    virtual sf::Int64 getSize()
+    {
+        return m_size;
+    }
+
+    // the number of reads that found no buffered data for their position
+    std::size_t getMissCount()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_missCount;
+    }
+
+private:
+
+    // the following functions must be called with the mutex locked
+
+    void restart(sf::Int64 position)
+    {
+        m_start = position;
+        m_head = 0;
+        m_filled = 0;
+        m_endOfStream = false;
+        m_error = false;
+        ++m_generation;
+    }
+
+    void discard(std::size_t count)
+    {
+        m_start += count;
+        m_head = (m_head + count) % m_buffer.size();
+        m_filled -= count;
+    }
+
+    // the function run by the reader thread
+    void readAhead()
+    {
+        std::vector<char> chunk(m_chunkSize);
+        sf::Int64 sourcePosition = 0;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (!m_stop)
+        {
+            // wait until there's room in the buffer, and something to read
+            if (m_filled >= m_limit || m_endOfStream || m_error)
+            {
+                m_dataWanted.wait(lock);
+                continue;
+            }
+
+            sf::Int64 target = m_start + static_cast<sf::Int64>(m_filled);
+            std::size_t size = std::min(m_chunkSize, m_limit - m_filled);
+            unsigned int generation = m_generation;
+
+            // read without holding the lock, so that the consumer can take
+            // the data that is already there
+            lock.unlock();
+
+            sf::Int64 count = -1;
+            if (sourcePosition == target || m_source->seek(target) == target)
+                count = m_source->read(&chunk[0], static_cast<sf::Int64>(size));
+            sourcePosition = count >= 0 ? target + count : -1;
+
+            lock.lock();
+
+            // the consumer jumped elsewhere in the meantime: this data is
+            // useless
+            if (generation != m_generation)
+                continue;
+
+            if (count < 0)
+            {
+                m_error = true;
+            }
+            else
+            {
+                std::size_t tail = (m_head + m_filled) % m_buffer.size();
+                std::size_t first = std::min(static_cast<std::size_t>(count), m_buffer.size() - tail);
+                std::memcpy(&m_buffer[tail], &chunk[0], first);
+                std::memcpy(&m_buffer[0], &chunk[first], static_cast<std::size_t>(count) - first);
+                m_filled += static_cast<std::size_t>(count);
+
+                // a source may return less than asked (network and
+                // decompressing streams often do): only an empty read, or
+                // reaching the size, means the end of the stream; otherwise
+                // the next iteration reads the rest
+                if (count == 0 || target + count >= m_size)
+                    m_endOfStream = true;
+            }
+
+            m_dataAvailable.notify_one();
+        }
+    }
+
+    sf::InputStream* m_source;
+    sf::Int64 m_size;
+    sf::Int64 m_position;
+
+    std::vector<char> m_buffer;
+    std::size_t m_chunkSize;
+    std::size_t m_head;
+    sf::Int64 m_start;
+    std::size_t m_filled;
+    std::size_t m_limit;          // how much to read ahead for now
+    unsigned int m_generation;    // incremented when reading ahead restarts
+    bool m_endOfStream;
+    bool m_error;
+    bool m_stop;
+    std::size_t m_missCount;
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_dataAvailable;
+    std::condition_variable m_dataWanted;
+};
+
+//Using it is the same as using any other stream: open the real stream, open
+//the read-ahead stream on it, and pass the read-ahead stream to the resource.
+//
+//    sf::FileInputStream file;
+//    ReadAheadStream stream;
+//    if (file.open("music.ogg") && stream.open(file))
+//        music.openFromStream(stream);
+
+//When the data is in a file, the system already reads ahead a little (and the
+//memory mapped streams tutorial shows how to ask for more). A read-ahead stream
+//is most useful with sources that do their own work on each read: network
+//streams, decrypting or decompressing streams, or streams over a slow device.
+
+/* Benchmark
+
+To simulate a slow device, the source is a stream that waits 5 milliseconds
+on every read. The consumer reads 16 KB every 10 milliseconds, a bit like an
+audio stream. We measure the longest time that a single read had to wait: this
+is what could make the sound stutter. The first read is not counted, since
+nothing can be read ahead before it.*/
+class SlowStream : public sf::InputStream
+{
+public:
+
+    explicit SlowStream(sf::InputStream& source) :
+    m_source(source)
+    {
+    }
+
+    virtual sf::Int64 read(void* data, sf::Int64 size)
+    {
+        sf::sleep(sf::milliseconds(5));
+        return m_source.read(data, size);
+    }
+
+    virtual sf::Int64 seek(sf::Int64 position)
+    {
+        return m_source.seek(position);
+    }
+
+    virtual sf::Int64 tell()
+    {
+        return m_source.tell();
+    }
+
+    virtual sf::Int64 getSize()
+    {
+        return m_source.getSize();
+    }
+
+private:
+
+    sf::InputStream& m_source;
+};
+
+sf::Time longestRead(sf::InputStream& stream)
+{
+    std::vector<char> buffer(16 * 1024);
+    sf::Time longest = sf::Time::Zero;
+
+    stream.seek(0);
+    for (int i = 0; i < 100; ++i)
+    {
+        sf::Clock clock;
+        if (stream.read(&buffer[0], buffer.size()) <= 0)
+            break;
+        if (i > 0)
+            longest = std::max(longest, clock.getElapsedTime());
+
+        // the rest of the work of the consumer
+        sf::sleep(sf::milliseconds(10));
+    }
+
+    return longest;
+}
+
+int main()
+{
+    std::vector<char> data(4 * 1024 * 1024);
+    for (std::size_t i = 0; i < data.size(); ++i)
+        data[i] = static_cast<char>(i);
+
+    sf::MemoryInputStream memory;
+    memory.open(&data[0], data.size());
+    SlowStream slow(memory);
+
+    std::cout << "direct:     " << longestRead(slow).asMilliseconds() << " ms" << std::endl;
+
+    ReadAheadStream stream;
+    if (!stream.open(slow))
+        return -1;
+
+    std::cout << "read-ahead: " << longestRead(stream).asMilliseconds() << " ms" << std::endl;
+    std::cout << stream.getMissCount() << " read(s) jumped outside the buffered data" << std::endl;
+
+    return 0;
+}
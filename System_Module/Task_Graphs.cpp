@@ -0,0 +1,655 @@
+/* Running the frame as a task graph
+
+compile with:  g++ -std=c++11 -O2 -c Task_Graphs.cpp
+and then link to get the executable with:
+
+    g++ Task_Graphs.o -o sfml-app -lsfml-graphics -lsfml-window -lsfml-system -pthread
+*/
+
+/* Introduction
+
+The update of a frame is usually a sequence of steps, run one after the other
+in the game loop:
+
+    physics -> animation -> particles -> transforms -> batching
+
+Most of these steps don't depend on each other. Animation and particles don't
+need the result of physics; only the transforms need physics and animation,
+and only batching needs everything. Run in sequence, they use a single core,
+while the others wait.
+
+A task graph describes the steps as tasks, and the dependencies between them
+as edges: "transforms" runs after "physics" and "animation", "batching" after
+"transforms" and "particles". A scheduler then runs each task as soon as all
+its predecessors are finished, on whatever core is free. Big steps can be
+split into several tasks (physics on four quarters of the entities) to use
+more cores.
+
+The scheduler below gives each thread its own queue of ready tasks (a deque).
+A thread pushes the tasks that its work makes ready to its own queue, and runs
+them itself, while their data is still in its cache. A thread whose queue is
+empty steals a task from the other end of another thread's queue. The threads
+never share a single queue, so they rarely wait for each other: this is work
+stealing.
+
+Finally, the scheduler records when each task ran, and on which thread. From
+this trace, the graph computes its critical path: the chain of dependent tasks
+which takes the longest. It is the shortest possible duration of the frame,
+whatever the number of cores, so it tells which task to optimize (or split)
+first.*/
+
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdlib>
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* The task graph
+
+Tasks are identified by their index. A graph can be built once and run every
+frame, or cleared and rebuilt when the work changes; in both cases, the tasks
+usually capture the game data by reference, and find everything they need
+there.
+
+The graph checks that it has no cycle (a task which indirectly depends on
+itself would never be ready) once after each modification, when it computes
+an order of its tasks in which every task comes after its predecessors. This
+order is then used to compute the critical path.*/
+class TaskGraph
+{
+public:
+
+    typedef std::size_t TaskId;
+
+    TaskId add(const std::string& name, const std::function<void()>& function)
+    {
+        Node node;
+        node.name = name;
+        node.function = function;
+        node.predecessorCount = 0;
+        node.start = 0;
+        node.end = 0;
+        node.worker = 0;
+        m_nodes.push_back(node);
+
+        m_order.clear();
+        return m_nodes.size() - 1;
+    }
+
+    // second will run after first is finished
+    void precede(TaskId first, TaskId second)
+    {
+        m_nodes[first].successors.push_back(second);
+        ++m_nodes[second].predecessorCount;
+
+        m_order.clear();
+    }
+
+    void clear()
+    {
+        m_nodes.clear();
+        m_order.clear();
+    }
+
+    std::size_t getTaskCount() const
+    {
+        return m_nodes.size();
+    }
+
+    // print when each task ran during the last run, and the critical path
+    void printTrace(std::ostream& stream) const
+    {
+        std::vector<TaskId> byStart(m_order);
+        std::sort(byStart.begin(), byStart.end(),
+                  [this](TaskId left, TaskId right) { return m_nodes[left].start < m_nodes[right].start; });
+
+        sf::Int64 frameEnd = 0;
+        for (std::size_t i = 0; i < byStart.size(); ++i)
+        {
+            const Node& node = m_nodes[byStart[i]];
+            stream << "thread " << node.worker << "  " << node.start << " - " << node.end << " us  " << node.name << std::endl;
+            frameEnd = std::max(frameEnd, node.end);
+        }
+
+        std::vector<TaskId> path = getCriticalPath();
+        sf::Int64 length = 0;
+        stream << "critical path:";
+        for (std::size_t i = 0; i < path.size(); ++i)
+        {
+            const Node& node = m_nodes[path[i]];
+            stream << (i > 0 ? " -> " : " ") << node.name << " (" << node.end - node.start << " us)";
+            length += node.end - node.start;
+        }
+        stream << std::endl << "  " << length << " us of a " << frameEnd << " us run" << std::endl;
+    }
+
+    // save the trace of the last run in the format of the Chrome trace viewer
+    // (open chrome://tracing, or https://ui.perfetto.dev, and load the file)
+    bool saveTrace(const std::string& filename) const
+    {
+        std::ofstream file(filename.c_str());
+        file << "[";
+        for (std::size_t i = 0; i < m_nodes.size(); ++i)
+        {
+            const Node& node = m_nodes[i];
+            file << (i > 0 ? ",\n" : "\n") << "{\"name\": \"" << node.name << "\", \"ph\": \"X\", \"ts\": " << node.start
+                 << ", \"dur\": " << node.end - node.start << ", \"pid\": 0, \"tid\": " << node.worker << "}";
+        }
+        file << "\n]\n";
+
+        return static_cast<bool>(file);
+    }
+
+    // the chain of dependent tasks with the longest total duration, in the
+    // last run
+    std::vector<TaskId> getCriticalPath() const
+    {
+        // the longest chain ending at each task, in an order where the
+        // predecessors of a task always come before it
+        std::vector<sf::Int64> length(m_nodes.size(), 0);
+        std::vector<TaskId> previous(m_nodes.size(), m_nodes.size());
+        for (std::size_t i = 0; i < m_order.size(); ++i)
+        {
+            TaskId task = m_order[i];
+            const Node& node = m_nodes[task];
+            length[task] += node.end - node.start;
+
+            for (std::size_t j = 0; j < node.successors.size(); ++j)
+            {
+                TaskId next = node.successors[j];
+                if (previous[next] == m_nodes.size() || length[task] > length[next])
+                {
+                    length[next] = length[task];
+                    previous[next] = task;
+                }
+            }
+        }
+
+        std::vector<TaskId> path;
+        if (m_order.empty())
+            return path;
+
+        for (TaskId task = std::max_element(length.begin(), length.end()) - length.begin();
+             task != m_nodes.size(); task = previous[task])
+            path.push_back(task);
+
+        std::reverse(path.begin(), path.end());
+        return path;
+    }
+
+private:
+
+    friend class Scheduler;
+
+    struct Node
+    {
+        std::string name;
+        std::function<void()> function;
+        std::vector<TaskId> successors;
+        unsigned int predecessorCount;
+
+        // the trace of the last run
+        sf::Int64 start;
+        sf::Int64 end;
+        unsigned int worker;
+    };
+
+    // compute m_order (Kahn's algorithm); false if the graph has a cycle
+    bool sort()
+    {
+        if (m_order.size() == m_nodes.size())
+            return true;
+
+        std::vector<unsigned int> count(m_nodes.size());
+        for (std::size_t i = 0; i < m_nodes.size(); ++i)
+        {
+            count[i] = m_nodes[i].predecessorCount;
+            if (count[i] == 0)
+                m_order.push_back(i);
+        }
+
+        for (std::size_t i = 0; i < m_order.size(); ++i)
+        {
+            const Node& node = m_nodes[m_order[i]];
+            for (std::size_t j = 0; j < node.successors.size(); ++j)
+            {
+                if (--count[node.successors[j]] == 0)
+                    m_order.push_back(node.successors[j]);
+            }
+        }
+
+        if (m_order.size() == m_nodes.size())
+            return true;
+
+        m_order.clear();
+        return false;
+    }
+
+    std::vector<Node> m_nodes;
+    std::vector<TaskId> m_order;   // empty when it must be computed again
+};
+
+/* The scheduler
+
+The thread which calls run takes part in the work, as the worker 0: with the
+default number of workers (one per core), the scheduler starts one thread less
+than there are cores. Between two runs, the other threads sleep.
+
+The queues are std::deque, each protected by its own mutex. The thread which
+owns a queue pushes and pops at the back (the most recent task, whose data is
+the most likely to be in its cache), thieves take from the front. Since each
+mutex is almost always taken by its owner only, locking it is cheap.
+
+A thread which finds no task anywhere goes to sleep on a condition variable.
+To avoid waking up threads for nothing, a thread which pushes a task only
+notifies if some thread sleeps; the counters of queued tasks and of sleeping
+threads are sequentially consistent atomics, so that a thread going to sleep
+and a thread pushing a task can't both miss each other.*/
+class Scheduler : sf::NonCopyable
+{
+public:
+
+    // workerCount includes the thread which calls run
+    explicit Scheduler(unsigned int workerCount = 0) :
+    m_graph(NULL),
+    m_pendingSize(0),
+    m_remaining(0),
+    m_queued(0),
+    m_sleeping(0),
+    m_stop(false)
+    {
+        if (workerCount == 0)
+            workerCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+        for (unsigned int i = 0; i < workerCount; ++i)
+            m_workers.push_back(std::unique_ptr<Worker>(new Worker));
+
+        for (unsigned int i = 1; i < workerCount; ++i)
+            m_threads.push_back(std::thread(&Scheduler::work, this, i));
+    }
+
+    ~Scheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_stop = true;
+        }
+        m_wakeUp.notify_all();
+
+        for (std::size_t i = 0; i < m_threads.size(); ++i)
+            m_threads[i].join();
+    }
+
+    unsigned int getWorkerCount() const
+    {
+        return static_cast<unsigned int>(m_workers.size());
+    }
+
+    // run all the tasks of the graph, and return when they are all finished;
+    // false if the graph has a cycle
+    bool run(TaskGraph& graph)
+    {
+        if (!graph.sort())
+            return false;
+
+        std::size_t count = graph.m_nodes.size();
+        if (count == 0)
+            return true;
+
+        if (m_pendingSize < count)
+        {
+            m_pending.reset(new std::atomic<unsigned int>[count]);
+            m_pendingSize = count;
+        }
+
+        for (std::size_t i = 0; i < count; ++i)
+            m_pending[i].store(graph.m_nodes[i].predecessorCount, std::memory_order_relaxed);
+
+        m_graph = &graph;
+        m_remaining.store(count);
+        m_clock.restart();
+
+        // give the tasks without predecessors to all the workers, so that
+        // they all start immediately
+        unsigned int worker = 0;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (graph.m_nodes[i].predecessorCount == 0)
+            {
+                push(worker, i);
+                worker = (worker + 1) % getWorkerCount();
+            }
+        }
+
+        // work until all the tasks are finished
+        while (m_remaining.load() > 0)
+        {
+            std::size_t task;
+            if (pop(0, task))
+            {
+                execute(0, task);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            ++m_sleeping;
+            while (m_queued.load() == 0 && m_remaining.load() > 0)
+                m_wakeUp.wait(lock);
+            --m_sleeping;
+        }
+
+        m_graph = NULL;
+        return true;
+    }
+
+private:
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> tasks;
+    };
+
+    void push(unsigned int worker, std::size_t task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_workers[worker]->mutex);
+            m_workers[worker]->tasks.push_back(task);
+        }
+
+        ++m_queued;
+        if (m_sleeping.load() > 0)
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_wakeUp.notify_one();
+        }
+    }
+
+    // take a task from our own queue, or steal one from another queue
+    bool pop(unsigned int worker, std::size_t& task)
+    {
+        for (unsigned int i = 0; i < getWorkerCount(); ++i)
+        {
+            Worker& victim = *m_workers[(worker + i) % getWorkerCount()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.tasks.empty())
+                continue;
+
+            if (i == 0)
+            {
+                task = victim.tasks.back();
+                victim.tasks.pop_back();
+            }
+            else
+            {
+                task = victim.tasks.front();
+                victim.tasks.pop_front();
+            }
+
+            --m_queued;
+            return true;
+        }
+
+        return false;
+    }
+
+    void execute(unsigned int worker, std::size_t task)
+    {
+        TaskGraph::Node& node = m_graph->m_nodes[task];
+        node.worker = worker;
+        node.start = m_clock.getElapsedTime().asMicroseconds();
+        node.function();
+        node.end = m_clock.getElapsedTime().asMicroseconds();
+
+        // the successors whose last predecessor was this task are ready; the
+        // decrement publishes the results of this task to the thread which
+        // will run them
+        for (std::size_t i = 0; i < node.successors.size(); ++i)
+        {
+            if (m_pending[node.successors[i]].fetch_sub(1, std::memory_order_acq_rel) == 1)
+                push(worker, node.successors[i]);
+        }
+
+        // the last task wakes up the thread waiting in run
+        if (m_remaining.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(m_sleepMutex);
+            m_wakeUp.notify_all();
+        }
+    }
+
+    // the function of the threads of the scheduler
+    void work(unsigned int worker)
+    {
+        while (true)
+        {
+            std::size_t task;
+            if (pop(worker, task))
+            {
+                execute(worker, task);
+                continue;
+            }
+
+            // tasks usually arrive in bursts: wait a little before sleeping
+            for (int i = 0; i < 100 && m_queued.load() == 0; ++i)
+                std::this_thread::yield();
+
+            std::unique_lock<std::mutex> lock(m_sleepMutex);
+            ++m_sleeping;
+            while (m_queued.load() == 0 && !m_stop)
+                m_wakeUp.wait(lock);
+            --m_sleeping;
+
+            if (m_stop && m_queued.load() == 0)
+                return;
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker> > m_workers;   // 0 is the thread which calls run
+    std::vector<std::thread> m_threads;
+    TaskGraph* m_graph;
+    std::unique_ptr<std::atomic<unsigned int>[]> m_pending;   // unfinished predecessors of each task
+    std::size_t m_pendingSize;
+    std::atomic<std::size_t> m_remaining;   // unfinished tasks
+    std::atomic<std::size_t> m_queued;      // tasks waiting in the queues
+    std::atomic<unsigned int> m_sleeping;   // threads waiting for a task
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wakeUp;
+    bool m_stop;
+    sf::Clock m_clock;
+};
+
+//The deques could be made lock-free (the Chase-Lev deque is the usual choice),
+//which saves a few tens of nanoseconds per task. With tasks of a few tens of
+//microseconds or more, like the steps of a frame, the mutexes don't show up in
+//the trace; make the tasks bigger before making the queues faster.
+
+//Tasks must not throw exceptions, and must not wait for each other: if a task
+//needs the result of another, it's a dependency, and it belongs in the graph.
+
+/* The frame
+
+The world below has moving entities and particles. Each frame:
+
+- physics moves the entities, in four tasks of a quarter of the entities each
+- animation advances the frame of each entity's animation
+- particles moves the particles
+- transforms computes the transform of each entity, from its position and its
+  animation: it needs physics and animation
+- batching builds the vertex array of the whole scene, as in the sprite
+  batching tutorial: it needs transforms and particles
+
+The graph is built once, and run every frame; drawing stays on the main
+thread, after the run. Press T to print the trace of the last frame, and save
+it to frame.json.*/
+struct World
+{
+    float dt;
+    std::vector<sf::Vector2f> positions;
+    std::vector<sf::Vector2f> velocities;
+    std::vector<float> animationTimes;
+    std::vector<sf::Vector2f> particles;
+    std::vector<sf::Vector2f> particleVelocities;
+    std::vector<sf::Transform> transforms;
+    sf::VertexArray vertices;
+};
+
+float randomFloat(float min, float max)
+{
+    return min + (max - min) * std::rand() / RAND_MAX;
+}
+
+void updatePhysics(World& world, std::size_t begin, std::size_t end)
+{
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        sf::Vector2f& position = world.positions[i];
+        sf::Vector2f& velocity = world.velocities[i];
+        position += velocity * world.dt;
+
+        // bounce on the sides of the window
+        if (position.x < 0 || position.x > 800)
+            velocity.x = -velocity.x;
+        if (position.y < 0 || position.y > 600)
+            velocity.y = -velocity.y;
+    }
+}
+
+void updateAnimation(World& world)
+{
+    for (std::size_t i = 0; i < world.animationTimes.size(); ++i)
+        world.animationTimes[i] += world.dt;
+}
+
+void updateParticles(World& world)
+{
+    for (std::size_t i = 0; i < world.particles.size(); ++i)
+    {
+        world.particleVelocities[i].y += 100 * world.dt;
+        world.particles[i] += world.particleVelocities[i] * world.dt;
+
+        // particles that leave the window start again from the top
+        if (world.particles[i].y > 600)
+            world.particles[i].y -= 600;
+    }
+}
+
+void updateTransforms(World& world)
+{
+    for (std::size_t i = 0; i < world.positions.size(); ++i)
+    {
+        // the animation makes the entities spin and pulse
+        float time = world.animationTimes[i];
+        float scale = 1.f + 0.25f * std::sin(time * 4);
+
+        sf::Transform transform;
+        transform.translate(world.positions[i]).rotate(time * 90).scale(scale, scale);
+        world.transforms[i] = transform;
+    }
+}
+
+void buildBatch(World& world)
+{
+    const sf::Vector2f corners[] = {sf::Vector2f(-2, -2), sf::Vector2f(2, -2), sf::Vector2f(2, 2), sf::Vector2f(-2, 2)};
+    std::size_t entityCount = world.transforms.size();
+    world.vertices.resize((entityCount + world.particles.size()) * 4);
+
+    for (std::size_t i = 0; i < entityCount; ++i)
+    {
+        for (std::size_t j = 0; j < 4; ++j)
+        {
+            world.vertices[i * 4 + j].position = world.transforms[i].transformPoint(corners[j]);
+            world.vertices[i * 4 + j].color = sf::Color(100, 200, 255);
+        }
+    }
+
+    for (std::size_t i = 0; i < world.particles.size(); ++i)
+    {
+        for (std::size_t j = 0; j < 4; ++j)
+        {
+            world.vertices[(entityCount + i) * 4 + j].position = world.particles[i] + corners[j] * 0.5f;
+            world.vertices[(entityCount + i) * 4 + j].color = sf::Color(255, 180, 80);
+        }
+    }
+}
+
+int main()
+{
+    const std::size_t entityCount = 40000;
+    const std::size_t particleCount = 100000;
+
+    World world;
+    world.dt = 0;
+    world.vertices.setPrimitiveType(sf::Quads);
+    world.transforms.resize(entityCount);
+    for (std::size_t i = 0; i < entityCount; ++i)
+    {
+        world.positions.push_back(sf::Vector2f(randomFloat(0, 800), randomFloat(0, 600)));
+        world.velocities.push_back(sf::Vector2f(randomFloat(-100, 100), randomFloat(-100, 100)));
+        world.animationTimes.push_back(randomFloat(0, 10));
+    }
+    for (std::size_t i = 0; i < particleCount; ++i)
+    {
+        world.particles.push_back(sf::Vector2f(randomFloat(0, 800), randomFloat(0, 600)));
+        world.particleVelocities.push_back(sf::Vector2f(randomFloat(-20, 20), randomFloat(0, 50)));
+    }
+
+    // the graph of the frame
+    TaskGraph graph;
+    TaskGraph::TaskId transforms = graph.add("transforms", std::bind(&updateTransforms, std::ref(world)));
+    TaskGraph::TaskId batching = graph.add("batching", std::bind(&buildBatch, std::ref(world)));
+    TaskGraph::TaskId animation = graph.add("animation", std::bind(&updateAnimation, std::ref(world)));
+    TaskGraph::TaskId particles = graph.add("particles", std::bind(&updateParticles, std::ref(world)));
+
+    for (std::size_t i = 0; i < 4; ++i)
+    {
+        TaskGraph::TaskId physics = graph.add("physics " + std::to_string(i),
+                                              std::bind(&updatePhysics, std::ref(world), entityCount * i / 4, entityCount * (i + 1) / 4));
+        graph.precede(physics, transforms);
+    }
+
+    graph.precede(animation, transforms);
+    graph.precede(transforms, batching);
+    graph.precede(particles, batching);
+
+    Scheduler scheduler;
+    std::cout << "running the frame on " << scheduler.getWorkerCount() << " threads" << std::endl;
+
+    sf::RenderWindow window(sf::VideoMode(800, 600), "Task graphs");
+    sf::Clock clock;
+
+    while (window.isOpen())
+    {
+        sf::Event event;
+        while (window.pollEvent(event))
+        {
+            if (event.type == sf::Event::Closed)
+                window.close();
+
+            if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::T)
+            {
+                graph.printTrace(std::cout);
+                graph.saveTrace("frame.json");
+            }
+        }
+
+        world.dt = clock.restart().asSeconds();
+        scheduler.run(graph);
+
+        window.clear();
+        window.draw(world.vertices);
+        window.display();
+    }
+
+    return 0;
+}
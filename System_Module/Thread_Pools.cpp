@@ -0,0 +1,353 @@
+/* Running tasks on a thread pool
+
+compile with:  g++ -std=c++11 -O2 -c Thread_Pools.cpp
+and then link to get the executable with:
+
+    g++ Thread_Pools.o -o sfml-app -lsfml-system -pthread
+*/
+
+/* Introduction
+
+The threads tutorial creates one sf::Thread for each thing to do in parallel.
+That's fine for a few long-lived threads (a loading thread, a network thread),
+but not for many small tasks:
+
+- creating and destroying a thread costs tens of microseconds, often more than
+  the task itself
+- the sf::Thread instance must live as long as its function runs, otherwise its
+  destructor blocks the caller (see the common mistakes section): there's no
+  way to just start a task and forget about it
+- with more threads than cores, the threads compete for the cores, and the
+  system spends its time switching between them
+
+A thread pool creates a fixed number of threads once, usually one per core,
+and keeps them waiting for tasks. Launching a task only puts it in a queue, and
+the first free thread runs it. The call returns a handle, which can be used to
+wait for the task, or ignored: the pool owns the task, not the caller.
+
+The pool below accepts the same entry points as sf::Thread: functions with or
+without an argument, member functions, functors and lambdas. Since SFML
+doesn't provide condition variables, it is built with std::thread,
+std::mutex and std::condition_variable.*/
+
+#include <SFML/System.hpp>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool;
+
+/* The task handle
+
+A handle refers to a counter of unfinished tasks, shared with the pool. A
+handle returned by launch counts a single task; the one returned by
+parallelFor counts all the parts of the loop. Handles are cheap to copy, and
+the counter stays alive as long as a handle or a queued task refers to it.*/
+class Task
+{
+public:
+
+    Task() :
+    m_pool(NULL)
+    {
+    }
+
+    bool isValid() const
+    {
+        return m_state != NULL;
+    }
+
+    bool isDone() const
+    {
+        return !m_state || m_state->remaining.load(std::memory_order_acquire) == 0;
+    }
+
+    // block until the task is finished; defined after ThreadPool
+    void wait() const;
+
+private:
+
+    friend class ThreadPool;
+
+    struct State
+    {
+        explicit State(unsigned int count) :
+        remaining(count)
+        {
+        }
+
+        std::atomic<unsigned int> remaining;
+    };
+
+    Task(ThreadPool* pool, const std::shared_ptr<State>& state) :
+    m_pool(pool),
+    m_state(state)
+    {
+    }
+
+    ThreadPool* m_pool;
+    std::shared_ptr<State> m_state;
+};
+
+/* The pool
+
+By default, the pool creates one thread per core, minus one for the main
+thread: a thread which waits for a task doesn't sleep, it runs other tasks of
+the queue until its own is finished. So the main thread works too while it
+waits, and waiting for a task from within another task can't block the pool.
+
+The destructor runs all the tasks that are still queued before it returns,
+like the destructor of sf::Thread waits for its function.
+
+Tasks must not throw exceptions: like with sf::Thread, an exception which
+escapes the function of a thread terminates the program.*/
+class ThreadPool : sf::NonCopyable
+{
+public:
+
+    explicit ThreadPool(unsigned int threadCount = 0) :
+    m_stop(false)
+    {
+        if (threadCount == 0)
+            threadCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+        for (unsigned int i = 0; i < threadCount; ++i)
+            m_threads.push_back(std::thread(&ThreadPool::work, this));
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_changed.notify_all();
+
+        for (std::size_t i = 0; i < m_threads.size(); ++i)
+            m_threads[i].join();
+    }
+
+    // the same entry points as sf::Thread
+
+    template <typename F>
+    Task launch(F function)
+    {
+        return push(std::function<void()>(function));
+    }
+
+    template <typename F, typename A>
+    Task launch(F function, A argument)
+    {
+        return push(std::function<void()>([=]() { function(argument); }));
+    }
+
+    template <typename C>
+    Task launch(void(C::*function)(), C* object)
+    {
+        return push(std::function<void()>([=]() { (object->*function)(); }));
+    }
+
+    // call function(begin, end) on parts of the range [0, count), in
+    // parallel; the parts are big enough to make the cost of each task
+    // negligible, and numerous enough to keep all the threads busy
+    Task parallelFor(std::size_t count, const std::function<void(std::size_t, std::size_t)>& function)
+    {
+        std::size_t parts = std::min<std::size_t>(count, (m_threads.size() + 1) * 4);
+        std::shared_ptr<Task::State> state = std::make_shared<Task::State>(static_cast<unsigned int>(parts));
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            for (std::size_t i = 0; i < parts; ++i)
+            {
+                std::size_t begin = count * i / parts;
+                std::size_t end = count * (i + 1) / parts;
+
+                Job job;
+                job.function = [=]() { function(begin, end); };
+                job.state = state;
+                m_queue.push_back(job);
+            }
+        }
+        m_changed.notify_all();
+
+        return Task(this, state);
+    }
+
+    // block until the task is finished, running other tasks meanwhile
+    void wait(const Task& task)
+    {
+        if (!task.m_state)
+            return;
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (task.m_state->remaining.load(std::memory_order_acquire) > 0)
+        {
+            if (m_queue.empty())
+            {
+                m_changed.wait(lock);
+                continue;
+            }
+
+            run(lock);
+        }
+
+        // the notification of a queued job may have woken this thread rather
+        // than a thread of the pool: pass it on
+        if (!m_queue.empty())
+            m_changed.notify_one();
+    }
+
+    unsigned int getThreadCount() const
+    {
+        return static_cast<unsigned int>(m_threads.size());
+    }
+
+private:
+
+    struct Job
+    {
+        std::function<void()> function;
+        std::shared_ptr<Task::State> state;
+    };
+
+    Task push(const std::function<void()>& function)
+    {
+        Job job;
+        job.function = function;
+        job.state = std::make_shared<Task::State>(1);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_queue.push_back(job);
+        }
+        m_changed.notify_one();
+
+        return Task(this, job.state);
+    }
+
+    // run the first job of the queue; the lock is released while it runs
+    void run(std::unique_lock<std::mutex>& lock)
+    {
+        Job job;
+        std::swap(job, m_queue.front());
+        m_queue.pop_front();
+
+        lock.unlock();
+        job.function();
+        lock.lock();
+
+        // wake up the threads which wait for this task; the mutex is locked,
+        // so a waiter can't miss it between its check and its wait
+        if (job.state->remaining.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            m_changed.notify_all();
+    }
+
+    // the function of each thread of the pool
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        while (true)
+        {
+            if (!m_queue.empty())
+                run(lock);
+            else if (m_stop)
+                return;
+            else
+                m_changed.wait(lock);
+        }
+    }
+
+    std::vector<std::thread> m_threads;
+    std::deque<Job> m_queue;
+    std::mutex m_mutex;
+    std::condition_variable m_changed;   // a job was queued, or a task finished
+    bool m_stop;
+};
+
+void Task::wait() const
+{
+    if (m_pool)
+        m_pool->wait(*this);
+}
+
+//Here is the example of the common mistakes section again. With a pool, the
+//task is queued and startThread returns immediately; the handle can be
+//ignored, the pool runs the function anyway.
+//
+//    ThreadPool pool;
+//
+//    void startThread()
+//    {
+//        pool.launch(&funcToRunInThread);
+//    }
+
+//Like with sf::Thread, the arguments of launch are copied: to pass an object
+//by reference, pass a pointer, or use std::ref. And like with sf::Thread, the
+//data used by several tasks must be protected, with a mutex or by giving each
+//task its own part of the data, as parallelFor does.
+
+//All the threads take their tasks from a single queue, protected by a mutex.
+//This is simple and fast enough for a few thousands of tasks per frame,
+//especially when they are launched with parallelFor, which locks the queue
+//once for all its parts. With many more (and smaller) tasks, the threads start
+//waiting for each other on this mutex; the task graphs tutorial shows how to
+//avoid that with a queue per thread.
+
+/* Benchmark
+
+Let's run 10000 small tasks (summing 1000 numbers each): first with one
+sf::Thread per task, then with one pool task per task, and finally with a
+single parallelFor. The results are written to separate slots, so the tasks
+don't need any mutex.*/
+void sumSlice(std::vector<double>* results, std::size_t index)
+{
+    double sum = 0;
+    for (int i = 0; i < 1000; ++i)
+        sum += (index + i) * 0.5;
+    (*results)[index] = sum;
+}
+
+int main()
+{
+    const std::size_t count = 10000;
+    std::vector<double> results(count);
+
+    sf::Clock clock;
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        sf::Thread thread(std::bind(&sumSlice, &results, i));
+        thread.launch();
+    }
+    sf::Time threadTime = clock.restart();
+
+    ThreadPool pool;
+    clock.restart();
+
+    std::vector<Task> tasks;
+    for (std::size_t i = 0; i < count; ++i)
+        tasks.push_back(pool.launch(std::bind(&sumSlice, &results, i)));
+    for (std::size_t i = 0; i < count; ++i)
+        tasks[i].wait();
+    sf::Time poolTime = clock.restart();
+
+    pool.parallelFor(count, [&](std::size_t begin, std::size_t end)
+    {
+        for (std::size_t i = begin; i < end; ++i)
+            sumSlice(&results, i);
+    }).wait();
+    sf::Time parallelForTime = clock.restart();
+
+    std::cout << pool.getThreadCount() << " threads in the pool" << std::endl;
+    std::cout << "one sf::Thread per task: " << threadTime.asMicroseconds() << " us" << std::endl;
+    std::cout << "ThreadPool::launch:      " << poolTime.asMicroseconds() << " us" << std::endl;
+    std::cout << "ThreadPool::parallelFor: " << parallelForTime.asMicroseconds() << " us" << std::endl;
+
+    return 0;
+}